@@ -1,5 +1,33 @@
 #include <iostream>
 #include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <bit>
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <array>
+#include <type_traits>
+#include <cstdio>
+#include <filesystem>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BHEAP_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define BHEAP_X86_SIMD 0
+#endif
 
 enum HeapExtrema {
 	HE_MAX,
@@ -10,72 +38,175 @@ constexpr HeapExtrema heap_flip(const HeapExtrema he) {
 	return HeapExtrema::HE_MAX == he ? HeapExtrema::HE_MIN : HeapExtrema::HE_MAX;
 }
 
-// Template Specialization
+/** Comparator family used by MHeap. `heap_order<HE>{}(a, b)` is true when `a` is allowed to
+ * sit above `b` in the heap. Custom comparators passed to MHeap follow the same contract. */
 template <HeapExtrema HE>
-bool heap_operator(int a, int b);
+struct heap_order;
 
 // MAX_HEAP Specialization
 template <>
-bool heap_operator<HeapExtrema::HE_MAX>(int a, int b) {
-	return a >= b;
-}
+struct heap_order<HeapExtrema::HE_MAX> {
+	template <typename T>
+	bool operator()(const T& a, const T& b) const {
+		return a >= b;
+	}
+};
 
 // MIN_HEAP Specialization
 template <>
-bool heap_operator<HeapExtrema::HE_MIN>(int a, int b) {
-	return a <= b;
+struct heap_order<HeapExtrema::HE_MIN> {
+	template <typename T>
+	bool operator()(const T& a, const T& b) const {
+		return a <= b;
+	}
+};
+
+template <HeapExtrema HE, typename T>
+bool heap_operator(const T& a, const T& b) {
+	return heap_order<HE>{}(a, b);
 }
 
-// Our HEAP Class/Struct
-template <HeapExtrema HE>
+// Our HEAP Class/Struct. ARITY is the number of children per node (2 gives the usual binary heap).
+// Elements are only ever moved, so move-only payloads are fine.
+template <HeapExtrema HE, typename T = int, size_t ARITY = 2, typename Compare = heap_order<HE>>
 struct MHeap {
-	std::vector<int> buffer;
+	static_assert(ARITY >= 2, "MHeap needs at least 2 children per node");
 
-	/** Given a vector and an initial node, swap 'keys' such that the heap property is maintained among
-	 * the tree starting at `initial node` and all substrees spawning from `initial_node` */
-	template <HeapExtrema H>
-	static std::vector<int>& heapify(std::vector<int>& data, int initial_node = 0) {
-		int honored_one = initial_node;
+	std::vector<T> buffer;
+	Compare cmp;
+
+	/** Index of the parent of node `i`. Undefined for the root. */
+	static constexpr size_t parent(const size_t i) {
+		return (i - 1) / ARITY;
+	}
+
+	/** Index of the leftmost child of node `i`. The other children follow it contiguously. */
+	static constexpr size_t first_child(const size_t i) {
+		return i * ARITY + 1;
+	}
+
+	/** Drops `moving` into the hole at `hole` and lets it sink until the heap property holds below it,
+	 * looking only at the first `size` elements of `data`. Children are moved up into the hole
+	 * instead of being swapped, so each level costs one move. */
+	static void sink(std::vector<T>& data, size_t hole, T moving, const Compare& cmp, size_t size) {
+		while (true) {
+			const size_t first = first_child(hole);
+			if (first >= size) {
+				break;
+			}
+
+			const size_t last = std::min(first + ARITY, size);
+			size_t best = first;
+			for (size_t child = first + 1; child < last; child++) {
+				best = cmp(data[best], data[child]) ? best : child;
+			}
+
+			if (cmp(moving, data[best])) {
+				break;
+			}
+
+			data[hole] = std::move(data[best]);
+			hole = best;
+		}
+
+		data[hole] = std::move(moving);
+	}
+
+	/** Same contract as `sink`, but bottom-up: the hole first follows the best child all the way down
+	 * to a leaf without looking at `moving`, then climbs back up until `moving` fits. An element taken
+	 * from the back of the heap almost always belongs near the bottom, so the climb is short and each
+	 * level costs ARITY - 1 comparisons instead of ARITY. It does move a few more elements, which is
+	 * why only heap_sort uses it; for fat payloads the moves cost more than the comparisons saved. */
+	static void sink_bottom_up(std::vector<T>& data, size_t hole, T moving, const Compare& cmp, size_t size) {
+		const size_t top = hole;
 
-		// while the stack is nonempty
-		while (honored_one != -1) {
-			const int cur = honored_one;
-			const int left = cur * 2 + 1;
-			const int right = cur * 2 + 2;
+		// descend to a leaf along the path of best children
+		while (true) {
+			const size_t first = first_child(hole);
+			if (first >= size) {
+				break;
+			}
 
-			int best = cur;
-			if (left < data.size() && !heap_operator<H>(data[cur], data[left])) {
-				best = heap_operator<H>(data[best], data[left]) ? best : left; 
+			const size_t last = std::min(first + ARITY, size);
+			size_t best = first;
+			for (size_t child = first + 1; child < last; child++) {
+				best = cmp(data[best], data[child]) ? best : child;
 			}
-			
-			if (right < data.size() && !heap_operator<H>(data[cur], data[right])) {
-				best = heap_operator<H>(data[best], data[right]) ? best : right; 
+
+			data[hole] = std::move(data[best]);
+			hole = best;
+		}
+
+		// climb back until the parent may sit above `moving`
+		while (hole > top) {
+			const size_t up = parent(hole);
+			if (cmp(data[up], moving)) {
+				break;
 			}
 
-			honored_one = -1;
-			if (best != cur) {
-				std::swap(data[cur], data[best]);
-				honored_one = best; 
+			data[hole] = std::move(data[up]);
+			hole = up;
+		}
+
+		data[hole] = std::move(moving);
+	}
+
+	/** Given a vector and an initial node, move 'keys' such that the heap property is maintained among
+	 * the tree starting at `initial node` and all substrees spawning from `initial_node` */
+	static std::vector<T>& heapify(std::vector<T>& data, size_t initial_node = 0, const Compare& cmp = Compare()) {
+		MHeap::sink(data, initial_node, std::move(data[initial_node]), cmp, data.size());
+		return data;
+	}
+
+	/** Moves the node at `node` towards the root until its parent honors the heap property */
+	static std::vector<T>& sift_up(std::vector<T>& data, size_t node, const Compare& cmp = Compare()) {
+		T moving = std::move(data[node]);
+		while (node > 0) {
+			const size_t up = parent(node);
+			if (cmp(data[up], moving)) {
+				break;
 			}
+
+			data[node] = std::move(data[up]);
+			node = up;
+		}
+
+		data[node] = std::move(moving);
+		return data;
+	}
+
+	/** Rearranges the list in a manner such that the Heap invariant is present in the underlying
+	 * buffer. Floyd's construction: heapify every internal node from the last one up, O(n). */
+	static std::vector<T>& make_heap(std::vector<T>& data, const Compare& cmp = Compare()) {
+		if (data.size() < 2) {
+			return data;
+		}
+
+		for (size_t i = parent(data.size() - 1) + 1; i-- > 0;) {
+			MHeap::heapify(data, i, cmp);
 		}
 
 		return data;
 	}
 
-	/** Sorts the list in a manner such that the Heap invariant is 
-	 * present in the underlying buffer */
-	template <HeapExtrema H>
-	static std::vector<int>& heap_sort(std::vector<int>& data) {
-		const int initial_node = data.size() / 2 - 1;
-		for (int i = initial_node; i >= 0; i--) {
-			data = MHeap::heapify<H>(data, i);
-	       	}
-		
+	/** Sorts the list in place. The front of the heap is moved to the back each round, so an
+	 * HE_MAX ordering yields ascending output (like std::sort_heap) and HE_MIN descending output. */
+	static std::vector<T>& heap_sort(std::vector<T>& data, const Compare& cmp = Compare()) {
+		MHeap::make_heap(data, cmp);
+
+		for (size_t end = data.size(); end-- > 1;) {
+			T moving = std::move(data[end]);
+			data[end] = std::move(data[0]);
+			MHeap::sink_bottom_up(data, 0, std::move(moving), cmp, end);
+		}
+
 		return data;
 	}
 
-	MHeap(std::vector<int>&& data) : buffer(data) {
-		MHeap::heap_sort<HE>(this->buffer);
+	MHeap(const Compare& cmp = Compare()) : buffer(), cmp(cmp) {}
+
+	MHeap(std::vector<T>&& data, const Compare& cmp = Compare()) : buffer(std::move(data)), cmp(cmp) {
+		MHeap::make_heap(this->buffer, this->cmp);
 	}
 
 	/** Return the heap type of the enum */
@@ -84,13 +215,13 @@ struct MHeap {
 	}
 
 	/** Look at the front element in the queue */
-	int peek() const {
+	const T& peek() const {
 		return this->buffer[0];
 	}
 
-	/** Exposes the underflying buffer */
-	std::vector<int> expose() {
-		return this->buffer;
+	/** Exposes the underflying buffer without copying it. Invalidated by any push or pop. */
+	std::span<const T> expose() const {
+		return std::span<const T>(this->buffer);
 	}
 
 	/** Evaluates to true if the heap is empty. */
@@ -98,29 +229,920 @@ struct MHeap {
 		return !(this->buffer.size() > 0);
 	}
 
+	/** Number of elements currently in the heap */
+	size_t size() const {
+		return this->buffer.size();
+	}
+
+	/** Inserts `item` into the heap in O(log n) */
+	void push(T&& item) {
+		this->buffer.push_back(std::move(item));
+		MHeap::sift_up(this->buffer, this->buffer.size() - 1, this->cmp);
+	}
+
+	/** Inserts a copy of `item` into the heap in O(log n) */
+	void push(const T& item) {
+		this->buffer.push_back(item);
+		MHeap::sift_up(this->buffer, this->buffer.size() - 1, this->cmp);
+	}
+
+	/** Constructs an element in place at the back of the buffer, then sifts it up */
+	template <typename... Args>
+	void emplace(Args&&... args) {
+		this->buffer.emplace_back(std::forward<Args>(args)...);
+		MHeap::sift_up(this->buffer, this->buffer.size() - 1, this->cmp);
+	}
+
+	/** Appends every element of [first, last) to the heap. Small batches are pushed one at a time.
+	 * Larger ones are appended as-is and then only the ancestors of the new slots are re-heapified,
+	 * level by level from the bottom (Floyd's construction restricted to the touched nodes). A batch
+	 * at least as large as the heap degenerates into a plain make_heap. */
+	template <typename Iter>
+	void push_bulk(Iter first, Iter last) {
+		const size_t old_size = this->buffer.size();
+		this->buffer.insert(this->buffer.end(), first, last);
+		const size_t new_size = this->buffer.size();
+		const size_t batch = new_size - old_size;
+
+		if (batch == 0) {
+			return;
+		}
+
+		// pushing costs O(log n) each in the worst case, the restricted Floyd pass O(batch + log^2 n)
+		if (batch < static_cast<size_t>(std::bit_width(new_size))) {
+			for (size_t i = old_size; i < new_size; i++) {
+				MHeap::sift_up(this->buffer, i, this->cmp);
+			}
+			return;
+		}
+
+		if (old_size == 0) {
+			MHeap::make_heap(this->buffer, this->cmp);
+			return;
+		}
+
+		size_t lo = parent(old_size);
+		size_t hi = parent(new_size - 1);
+		while (true) {
+			for (size_t i = hi + 1; i-- > lo;) {
+				MHeap::heapify(this->buffer, i, this->cmp);
+			}
+
+			if (lo == 0) {
+				break;
+			}
+
+			lo = parent(lo);
+			hi = parent(hi);
+		}
+	}
+
+	/** Moves a whole batch into the heap, see the iterator overload */
+	void push_bulk(std::vector<T>&& batch) {
+		this->push_bulk(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+	}
+
 	/** Extracts the leading value in the queue, and replaces the "root"
 	 * of the heap with the next most 'extreme' value */
-	int pop_front() {
-		int top = this->peek();
-		std::swap(this->buffer[0], this->buffer[this->buffer.size()-1]);
-		this->buffer.erase(this->buffer.end() - 1);
-		this->buffer = MHeap::heapify<HE>(this->buffer, 0);
+	T pop_front() {
+		T top = std::move(this->buffer[0]);
+		T last = std::move(this->buffer.back());
+		this->buffer.pop_back();
+		if (!this->buffer.empty()) {
+			MHeap::sink(this->buffer, 0, std::move(last), this->cmp, this->buffer.size());
+		}
+
+		return top;
+	}
+
+	/** Swaps the front of the heap for `item` with a single sift, and returns the old front.
+	 * Cheaper than a pop_front followed by a push. */
+	T replace_front(T item) {
+		T top = std::move(this->buffer[0]);
+		MHeap::sink(this->buffer, 0, std::move(item), this->cmp, this->buffer.size());
+		return top;
+	}
+};
+
+/** Stable reference to an element pushed into an IndexedMHeap. It stays valid until
+ * that element is popped, after which the handle may be recycled by a later push. */
+typedef size_t HeapHandle;
+
+/** An MHeap that remembers where each of its elements lives, so that keys can be changed
+ * after insertion (decrease_key / update) through the handle returned by push. */
+template <HeapExtrema HE, typename T = int, size_t ARITY = 2, typename Compare = heap_order<HE>>
+struct IndexedMHeap {
+	typedef MHeap<HE, T, ARITY, Compare> Layout;
+	static constexpr size_t NOT_IN_HEAP = static_cast<size_t>(-1);
+
+	struct Entry {
+		T key;
+		HeapHandle handle;
+	};
+
+	std::vector<Entry> buffer;
+	std::vector<size_t> positions; // handle -> index into `buffer`
+	std::vector<HeapHandle> free_handles;
+	Compare cmp;
+
+	IndexedMHeap(const Compare& cmp = Compare()) : buffer(), positions(), free_handles(), cmp(cmp) {}
+
+	/** Reserves space for `n` elements so pushes do not reallocate */
+	void reserve(size_t n) {
+		this->buffer.reserve(n);
+		this->positions.reserve(n);
+	}
+
+	/** Return the heap type of the enum */
+	HeapExtrema heap_type() const {
+		return HE;
+	}
+
+	/** Evaluates to true if the heap is empty. */
+	bool empty() const {
+		return this->buffer.empty();
+	}
+
+	/** Number of elements currently in the heap */
+	size_t size() const {
+		return this->buffer.size();
+	}
+
+	/** Evaluates to true if `h` refers to an element that is still in the heap */
+	bool contains(HeapHandle h) const {
+		return h < this->positions.size() && this->positions[h] != NOT_IN_HEAP;
+	}
+
+	/** The current key of the element behind `h` */
+	const T& key_of(HeapHandle h) const {
+		return this->buffer[this->positions[h]].key;
+	}
+
+	/** Look at the front key in the queue */
+	const T& peek() const {
+		return this->buffer[0].key;
+	}
+
+	/** Handle of the front element in the queue */
+	HeapHandle peek_handle() const {
+		return this->buffer[0].handle;
+	}
+
+	/** Inserts `key` and returns the handle it can later be updated through */
+	HeapHandle push(T key) {
+		HeapHandle h;
+		if (this->free_handles.empty()) {
+			h = this->positions.size();
+			this->positions.push_back(0);
+		} else {
+			h = this->free_handles.back();
+			this->free_handles.pop_back();
+		}
+
+		this->buffer.push_back(Entry { std::move(key), h });
+		this->sift_up(this->buffer.size() - 1);
+		return h;
+	}
+
+	/** Removes the front element and returns it along with its (now released) handle */
+	Entry pop() {
+		Entry top = std::move(this->buffer[0]);
+		this->positions[top.handle] = NOT_IN_HEAP;
+		this->free_handles.push_back(top.handle);
+
+		Entry last = std::move(this->buffer.back());
+		this->buffer.pop_back();
+		if (!this->buffer.empty()) {
+			this->sink(0, std::move(last));
+		}
+
+		return top;
+	}
+
+	/** Extracts the leading key in the queue */
+	T pop_front() {
+		return std::move(this->pop().key);
+	}
+
+	/** Changes the key behind `h` to `key` and restores the heap property in either direction */
+	void update(HeapHandle h, T key) {
+		const size_t pos = this->positions[h];
+		this->buffer[pos].key = std::move(key);
+
+		if (pos > 0 && !this->cmp(this->buffer[Layout::parent(pos)].key, this->buffer[pos].key)) {
+			this->sift_up(pos);
+		} else {
+			this->sink(pos, std::move(this->buffer[pos]));
+		}
+	}
+
+	/** Moves the key behind `h` towards the front: a smaller key for HE_MIN, a larger one for HE_MAX,
+	 * or in general one that `cmp` allows to sit at least as high as the current key. */
+	void decrease_key(HeapHandle h, T key) {
+		if (!this->cmp(key, this->key_of(h))) {
+			std::cout << "decrease_key was given a key that would sit below the current key" << std::endl;
+			abort();
+		}
+
+		this->update(h, std::move(key));
+	}
+
+private:
+	void place(size_t pos, Entry&& e) {
+		this->positions[e.handle] = pos;
+		this->buffer[pos] = std::move(e);
+	}
+
+	void sift_up(size_t node) {
+		Entry moving = std::move(this->buffer[node]);
+		while (node > 0) {
+			const size_t up = Layout::parent(node);
+			if (this->cmp(this->buffer[up].key, moving.key)) {
+				break;
+			}
+
+			this->place(node, std::move(this->buffer[up]));
+			node = up;
+		}
+
+		this->place(node, std::move(moving));
+	}
+
+	void sink(size_t hole, Entry moving) {
+		const size_t size = this->buffer.size();
+		while (true) {
+			const size_t first = Layout::first_child(hole);
+			if (first >= size) {
+				break;
+			}
+
+			const size_t last = std::min(first + ARITY, size);
+			size_t best = first;
+			for (size_t child = first + 1; child < last; child++) {
+				best = this->cmp(this->buffer[best].key, this->buffer[child].key) ? best : child;
+			}
+
+			if (this->cmp(moving.key, this->buffer[best].key)) {
+				break;
+			}
+
+			this->place(hole, std::move(this->buffer[best]));
+			hole = best;
+		}
+
+		this->place(hole, std::move(moving));
+	}
+};
+
+/** Evaluates to true if the CPU we are running on has AVX2. Checked once. */
+inline bool cpu_has_avx2() {
+#if BHEAP_X86_SIMD
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+#else
+	return false;
+#endif
+}
+
+/** Index of the first element of data[0..n) that strictly beats `threshold` in HE order
+ * (greater for HE_MAX, smaller for HE_MIN), or n if there is none. */
+template <HeapExtrema HE>
+size_t find_beating_scalar(const int* data, size_t n, int threshold) {
+	for (size_t i = 0; i < n; i++) {
+		if (!heap_operator<heap_flip(HE)>(data[i], threshold)) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+#if BHEAP_X86_SIMD
+/** find_beating_scalar, 8 lanes at a time. A whole block of losers costs one compare and one movemask. */
+template <HeapExtrema HE>
+__attribute__((target("avx2")))
+size_t find_beating_avx2(const int* data, size_t n, int threshold) {
+	const __m256i thr = _mm256_set1_epi32(threshold);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const __m256i beats = HE == HE_MAX ? _mm256_cmpgt_epi32(block, thr) : _mm256_cmpgt_epi32(thr, block);
+		const unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(beats)));
+		if (mask != 0) {
+			return i + static_cast<size_t>(std::countr_zero(mask));
+		}
+	}
+
+	return i + find_beating_scalar<HE>(data + i, n - i, threshold);
+}
+#endif
+
+/** Keeps the K most HE elements offered so far (HE_MAX: the K largest), for streams far too long to
+ * keep around. Built on an MHeap of the opposite extrema, so the weakest element kept sits at the front
+ * and acts as the admission threshold: an element that does not beat it is rejected after a single
+ * comparison, without touching the heap. Per-thread instances can be combined with merge(). */
+template <HeapExtrema HE = HE_MAX, typename T = int>
+class TopK {
+private:
+	MHeap<heap_flip(HE), T> m_heap;
+	size_t m_k;
+
+public:
+	TopK(size_t k) : m_heap(), m_k(k) {
+		this->m_heap.buffer.reserve(k);
+	}
+
+	/** Return the heap type of the enum */
+	HeapExtrema heap_type() const {
+		return HE;
+	}
+
+	/** The K this selector was built with */
+	size_t capacity() const {
+		return this->m_k;
+	}
+
+	/** Number of elements kept so far, at most capacity() */
+	size_t size() const {
+		return this->m_heap.size();
+	}
+
+	/** Evaluates to true if nothing has been kept yet */
+	bool empty() const {
+		return this->m_heap.empty();
+	}
+
+	/** Evaluates to true once K elements are kept and new ones have to beat threshold() */
+	bool full() const {
+		return this->m_heap.size() >= this->m_k;
+	}
+
+	/** The weakest element kept. Once full, an element has to beat this to get in. */
+	const T& threshold() const {
+		return this->m_heap.peek();
+	}
+
+	/** Offers `item`. Returns true if it was kept. */
+	bool offer(const T& item) {
+		if (this->m_k == 0) {
+			return false;
+		}
+
+		if (!this->full()) {
+			this->m_heap.push(item);
+			return true;
+		}
+
+		if (heap_operator<heap_flip(HE)>(item, this->m_heap.peek())) {
+			return false;
+		}
+
+		this->m_heap.replace_front(T(item));
+		return true;
+	}
+
+	/** Offers a whole batch. For ints the elements that cannot beat the current threshold are skipped
+	 * 8 at a time with AVX2 when the CPU has it, and one at a time otherwise. */
+	void offer(std::span<const T> batch) {
+		if constexpr (std::is_same_v<T, int>) {
+			if (this->m_k == 0) {
+				return;
+			}
+
+			const size_t n = batch.size();
+			size_t i = 0;
+			while (i < n && !this->full()) {
+				this->offer(batch[i]);
+				i += 1;
+			}
+
+			while (i < n) {
+#if BHEAP_X86_SIMD
+				i += cpu_has_avx2()
+					? find_beating_avx2<HE>(batch.data() + i, n - i, this->m_heap.peek())
+					: find_beating_scalar<HE>(batch.data() + i, n - i, this->m_heap.peek());
+#else
+				i += find_beating_scalar<HE>(batch.data() + i, n - i, this->m_heap.peek());
+#endif
+				if (i < n) {
+					this->m_heap.replace_front(int(batch[i]));
+					i += 1;
+				}
+			}
+		} else {
+			for (const T& item : batch) {
+				this->offer(item);
+			}
+		}
+	}
+
+	/** Folds another selector's elements into this one, e.g. the per-thread selectors of a parallel scan */
+	void merge(const TopK& other) {
+		this->offer(other.expose());
+	}
+
+	/** The kept elements in heap order. Invalidated by the next offer. */
+	std::span<const T> expose() const {
+		return this->m_heap.expose();
+	}
+
+	/** The kept elements, best first */
+	std::vector<T> sorted() const {
+		std::vector<T> out(this->m_heap.buffer.begin(), this->m_heap.buffer.end());
+		MHeap<heap_flip(HE), T>::heap_sort(out);
+		return out;
+	}
+};
+
+/** Key projection used by RadixHeap when the elements are their own keys */
+struct radix_identity {
+	template <typename K>
+	K operator()(const K& key) const {
+		return key;
+	}
+};
+
+/** A min-heap for monotone unsigned integer priorities: no key pushed may be smaller than the last
+ * key popped, which is what Dijkstra-style searches produce. Elements live in buckets
+ * indexed by the highest bit in which their key differs from the last popped key. Only when the front
+ * is needed and bucket 0 (keys equal to the last popped key) is empty is the lowest non-empty bucket
+ * redistributed around its minimum. Every element can only ever move to lower buckets, so each
+ * push/pop is amortized O(log C) where C is the key range, and elements are never compared. */
+template <typename T = uint32_t, typename KeyOf = radix_identity>
+class RadixHeap {
+private:
+	typedef std::invoke_result_t<KeyOf, const T&> Key;
+	static_assert(std::is_unsigned_v<Key>, "RadixHeap needs unsigned integer keys");
+	static constexpr size_t BUCKETS = std::numeric_limits<Key>::digits + 1;
+
+	std::array<std::vector<T>, BUCKETS> m_buckets;
+	Key m_last;                  // key of the last popped element, the base every bucket is relative to
+	size_t m_size;
+	KeyOf m_key_of;
+	mutable const T* m_front;    // front found by peek() while bucket 0 is empty, reset by push and pop
+
+	/** Bucket `key` belongs in, relative to the last popped key */
+	static size_t bucket_of(const Key key, const Key last) {
+		return static_cast<size_t>(std::bit_width(static_cast<Key>(key ^ last)));
+	}
+
+	/** Makes sure bucket 0 holds the front of the heap, unless the heap is empty. Moves m_last up to
+	 * the front's key, so only pop_front may call it. */
+	void refill() {
+		if (this->m_size == 0 || !this->m_buckets[0].empty()) {
+			return;
+		}
+
+		size_t lowest = 1;
+		while (this->m_buckets[lowest].empty()) {
+			lowest += 1;
+		}
+
+		std::vector<T>& source = this->m_buckets[lowest];
+		Key new_last = this->m_key_of(source[0]);
+		for (const T& item : source) {
+			new_last = std::min(new_last, this->m_key_of(item));
+		}
+
+		this->m_last = new_last;
+		for (T& item : source) {
+			const Key key = this->m_key_of(item);
+			this->m_buckets[RadixHeap::bucket_of(key, new_last)].push_back(std::move(item));
+		}
+		source.clear();
+	}
+
+public:
+	RadixHeap(const KeyOf& key_of = KeyOf()) : m_buckets(), m_last(0), m_size(0), m_key_of(key_of), m_front(nullptr) {}
+
+	/** Return the heap type of the enum. Radix heaps only ever hand out the minimum. */
+	HeapExtrema heap_type() const {
+		return HE_MIN;
+	}
+
+	/** Look at the front element in the queue. Nothing is redistributed, so pushes are still only
+	 * bounded by the last popped key. The lowest bucket is scanned once and the result kept until
+	 * the next push or pop. */
+	const T& peek() const {
+		if (!this->m_buckets[0].empty()) {
+			return this->m_buckets[0].back();
+		}
+
+		if (this->m_front == nullptr) {
+			size_t lowest = 1;
+			while (this->m_buckets[lowest].empty()) {
+				lowest += 1;
+			}
+
+			const std::vector<T>& source = this->m_buckets[lowest];
+			this->m_front = &source[0];
+			for (const T& item : source) {
+				this->m_front = this->m_key_of(item) < this->m_key_of(*this->m_front) ? &item : this->m_front;
+			}
+		}
+
+		return *this->m_front;
+	}
+
+	/** Evaluates to true if the heap is empty. */
+	bool empty() const {
+		return this->m_size == 0;
+	}
+
+	/** Number of elements currently in the heap */
+	size_t size() const {
+		return this->m_size;
+	}
+
+	/** Inserts `item`. Its key must not be smaller than the key of the last popped element. */
+	void push(T item) {
+		const Key key = this->m_key_of(item);
+		if (key < this->m_last) {
+			std::cout << "RadixHeap::push was given a key smaller than the last popped key" << std::endl;
+			abort();
+		}
+
+		this->m_buckets[RadixHeap::bucket_of(key, this->m_last)].push_back(std::move(item));
+		this->m_size += 1;
+		this->m_front = nullptr;
+	}
+
+	/** Extracts the leading (smallest) value in the queue */
+	T pop_front() {
+		this->refill();
+		T top = std::move(this->m_buckets[0].back());
+		this->m_buckets[0].pop_back();
+		this->m_size -= 1;
+		this->m_front = nullptr;
+		return top;
+	}
+};
+
+/** Buffered sequential reader over a run file of raw T records. Reads `buffer_elems` records at a
+ * time so the merge touches the disk in large sequential chunks. */
+template <typename T>
+class RunReader {
+private:
+	static_assert(std::is_trivially_copyable_v<T>, "run files hold raw T records");
+
+	std::FILE* m_file;
+	std::vector<T> m_buffer;
+	size_t m_pos;
+	size_t m_count;
+
+	void refill() {
+		this->m_count = std::fread(this->m_buffer.data(), sizeof(T), this->m_buffer.size(), this->m_file);
+		this->m_pos = 0;
+		if (std::ferror(this->m_file)) {
+			std::cout << "could not read run file" << std::endl;
+			abort();
+		}
+	}
+
+public:
+	RunReader(const std::string& path, size_t buffer_elems) : m_file(std::fopen(path.c_str(), "rb")), m_buffer(std::max<size_t>(1, buffer_elems)), m_pos(0), m_count(0) {
+		if (this->m_file == nullptr) {
+			std::cout << "could not open run file " << path << std::endl;
+			abort();
+		}
+
+		std::setvbuf(this->m_file, nullptr, _IONBF, 0);
+		this->refill();
+	}
+
+	RunReader(RunReader&& other) : m_file(other.m_file), m_buffer(std::move(other.m_buffer)), m_pos(other.m_pos), m_count(other.m_count) {
+		other.m_file = nullptr;
+	}
+
+	RunReader(const RunReader&) = delete;
+
+	~RunReader() {
+		if (this->m_file != nullptr) {
+			std::fclose(this->m_file);
+		}
+	}
+
+	/** Evaluates to true once every record of the run has been consumed */
+	bool exhausted() const {
+		return this->m_pos >= this->m_count;
+	}
+
+	/** The record the reader is currently sitting on */
+	const T& current() const {
+		return this->m_buffer[this->m_pos];
+	}
+
+	/** Moves to the next record, reading the next chunk when the buffer runs out */
+	void advance() {
+		this->m_pos += 1;
+		if (this->m_pos == this->m_count && this->m_count == this->m_buffer.size()) {
+			this->refill();
+		}
+	}
+};
+
+/** Buffered sequential writer of raw T records, the counterpart of RunReader */
+template <typename T>
+class RunWriter {
+private:
+	static_assert(std::is_trivially_copyable_v<T>, "run files hold raw T records");
+
+	std::FILE* m_file;
+	std::vector<T> m_buffer;
+	size_t m_count;
+
+public:
+	RunWriter(const std::string& path, size_t buffer_elems) : m_file(std::fopen(path.c_str(), "wb")), m_buffer(std::max<size_t>(1, buffer_elems)), m_count(0) {
+		if (this->m_file == nullptr) {
+			std::cout << "could not open output file " << path << std::endl;
+			abort();
+		}
+
+		std::setvbuf(this->m_file, nullptr, _IONBF, 0);
+	}
+
+	RunWriter(const RunWriter&) = delete;
+
+	~RunWriter() {
+		this->flush();
+		if (std::fclose(this->m_file) != 0) {
+			std::cout << "could not close output file" << std::endl;
+			abort();
+		}
+	}
+
+	void push(const T& item) {
+		this->m_buffer[this->m_count] = item;
+		this->m_count += 1;
+		if (this->m_count == this->m_buffer.size()) {
+			this->flush();
+		}
+	}
+
+	void flush() {
+		if (std::fwrite(this->m_buffer.data(), sizeof(T), this->m_count, this->m_file) != this->m_count) {
+			std::cout << "could not write output file" << std::endl;
+			abort();
+		}
+		this->m_count = 0;
+	}
+};
+
+/** A tournament tree over k sorted sources, for k-way merging. Each internal node remembers the
+ * loser of the match played there and the overall winner sits in slot 0, so after the winner's
+ * source advances only the matches on its leaf-to-root path are replayed: ceil(log2 k) comparisons
+ * per element, against the stored losers only, and no allocation after construction.
+ *
+ * `Source` needs `exhausted()`, `current()` and `advance()`, like RunReader. An exhausted source
+ * loses every match, so the tree needs no sentinel value. Surface mirrors MHeap. */
+template <HeapExtrema HE, typename Source, typename Compare = heap_order<HE>>
+class LoserTree {
+private:
+	typedef std::decay_t<decltype(std::declval<const Source&>().current())> T;
+
+	std::vector<Source>& m_sources;
+	std::vector<size_t> m_tree;   // m_tree[0] is the winner, m_tree[1..k) the loser at each internal node
+	std::vector<T> m_heads;       // copy of each source's current element, so matches stay in one array
+	std::vector<uint32_t> m_live; // 0 once a source is exhausted (not char, which would alias everything)
+	Compare m_cmp;
+
+	/** Evaluates to true if source `a` should be emitted before source `b` */
+	bool beats(const size_t a, const size_t b) const {
+		// bitwise instead of short-circuit on purpose: merge outcomes are unpredictable, so this
+		// should compile to conditional moves rather than branches
+		return this->m_live[a] & (!this->m_live[b] | this->m_cmp(this->m_heads[a], this->m_heads[b]));
+	}
+
+	/** Refreshes the cached head of source `i` */
+	void load_head(const size_t i) {
+		this->m_live[i] = !this->m_sources[i].exhausted();
+		if (this->m_live[i]) {
+			this->m_heads[i] = this->m_sources[i].current();
+		}
+	}
+
+public:
+	LoserTree(std::vector<Source>& sources, const Compare& cmp = Compare())
+		: m_sources(sources), m_tree(std::max<size_t>(1, sources.size())), m_heads(sources.size()), m_live(sources.size()), m_cmp(cmp) {
+		// Internal nodes are 1..k-1 and the leaf of source i is k + i, so node n plays its children
+		// 2n and 2n + 1. Play every match bottom-up once, keeping winners on the side.
+		const size_t k = sources.size();
+		std::vector<size_t> winner(2 * k);
+		for (size_t i = 0; i < k; i++) {
+			winner[k + i] = i;
+			this->load_head(i);
+		}
+
+		for (size_t node = k; node-- > 1;) {
+			const size_t a = winner[2 * node];
+			const size_t b = winner[2 * node + 1];
+			const bool a_wins = this->beats(a, b);
+			winner[node] = a_wins ? a : b;
+			this->m_tree[node] = a_wins ? b : a;
+		}
+
+		this->m_tree[0] = k > 1 ? winner[1] : 0;
+	}
+
+	/** Return the heap type of the enum */
+	HeapExtrema heap_type() const {
+		return HE;
+	}
+
+	/** Evaluates to true once every source is exhausted */
+	bool empty() const {
+		return this->m_sources.empty() || !this->m_live[this->m_tree[0]];
+	}
+
+	/** Look at the front element across all sources */
+	const T& peek() const {
+		return this->m_heads[this->m_tree[0]];
+	}
+
+	/** Extracts the front element and replays the winner's path */
+	T pop_front() {
+		size_t winner = this->m_tree[0];
+		T top = this->m_heads[winner];
+		this->m_sources[winner].advance();
+		this->load_head(winner);
+
+		for (size_t node = (this->m_sources.size() + winner) / 2; node > 0; node /= 2) {
+			const size_t loser = this->m_tree[node];
+			const bool upset = this->beats(loser, winner);
+			this->m_tree[node] = upset ? winner : loser;
+			winner = upset ? loser : winner;
+		}
+
+		this->m_tree[0] = winner;
 		return top;
 	}
 };
 
+/** Merges the sorted run files `run_paths` into `out_path`, each run getting `buffer_bytes` of
+ * read-ahead. Runs must be sorted according to HE (ascending for HE_MIN). Returns the number of
+ * records written. */
+template <HeapExtrema HE, typename T = int, typename Compare = heap_order<HE>>
+size_t merge_runs(const std::vector<std::string>& run_paths, const std::string& out_path, size_t buffer_bytes, const Compare& cmp = Compare()) {
+	const size_t buffer_elems = std::max<size_t>(1, buffer_bytes / sizeof(T));
+
+	std::vector<RunReader<T>> runs;
+	runs.reserve(run_paths.size());
+	for (const std::string& path : run_paths) {
+		runs.emplace_back(path, buffer_elems);
+	}
+
+	RunWriter<T> out(out_path, buffer_elems);
+	LoserTree<HE, RunReader<T>, Compare> tree(runs, cmp);
+
+	size_t written = 0;
+	while (!tree.empty()) {
+		out.push(tree.pop_front());
+		written += 1;
+	}
+
+	return written;
+}
+
+/** Per-thread xorshift generator. Cheap enough to call on every push/pop. */
+inline uint64_t thread_random() {
+	static thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ std::hash<std::thread::id>{}(std::this_thread::get_id());
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/** A relaxed concurrent priority queue. It holds `shards_per_thread * threads` MHeaps, each behind its
+ * own lock. A push goes to a random shard; a pop samples two shards and takes the better of their two
+ * fronts. Pops are therefore only approximately in heap order (the expected rank error is O(#shards)),
+ * in exchange for threads almost never waiting on the same lock. All locking is try_lock: a shard that
+ * is busy is skipped and another one is sampled instead. */
+template <HeapExtrema HE, typename T = int, size_t ARITY = 2, typename Compare = heap_order<HE>>
+class MultiQueue {
+private:
+	struct alignas(64) Shard {
+		std::mutex lock;
+		MHeap<HE, T, ARITY, Compare> heap;
+	};
+
+	size_t m_num_shards;
+	std::unique_ptr<Shard[]> m_shards;
+	std::atomic<size_t> m_size;
+	Compare m_cmp;
+
+	size_t random_shard() const {
+		return static_cast<size_t>(thread_random() % this->m_num_shards);
+	}
+
+public:
+	MultiQueue(size_t threads, size_t shards_per_thread = 2, const Compare& cmp = Compare())
+		: m_num_shards(std::max<size_t>(2, threads * shards_per_thread)),
+		m_shards(new Shard[std::max<size_t>(2, threads * shards_per_thread)]),
+		m_size(0),
+		m_cmp(cmp) {}
+
+	/** Return the heap type of the enum */
+	HeapExtrema heap_type() const {
+		return HE;
+	}
+
+	/** Number of shards the elements are spread over */
+	size_t shards() const {
+		return this->m_num_shards;
+	}
+
+	/** Number of elements in the queue. Only a snapshot while other threads are working. */
+	size_t size() const {
+		return this->m_size.load(std::memory_order_relaxed);
+	}
+
+	/** Evaluates to true if the queue is empty. Only a snapshot while other threads are working. */
+	bool empty() const {
+		return this->size() == 0;
+	}
+
+	/** Inserts `item` into the first random shard whose lock is free */
+	void push(T item) {
+		while (true) {
+			Shard& shard = this->m_shards[this->random_shard()];
+			if (shard.lock.try_lock()) {
+				shard.heap.push(std::move(item));
+				this->m_size.fetch_add(1, std::memory_order_relaxed);
+				shard.lock.unlock();
+				return;
+			}
+		}
+	}
+
+	/** Pops the better front of two random shards into `out`. Returns false once the queue is empty. */
+	bool try_pop(T& out) {
+		while (this->m_size.load(std::memory_order_relaxed) > 0) {
+			const size_t i = this->random_shard();
+			size_t j = this->random_shard();
+			if (i == j) {
+				j = (j + 1) % this->m_num_shards;
+			}
+
+			Shard& a = this->m_shards[i];
+			if (!a.lock.try_lock()) {
+				continue;
+			}
+
+			Shard& b = this->m_shards[j];
+			if (!b.lock.try_lock()) {
+				a.lock.unlock();
+				continue;
+			}
+
+			Shard* best = nullptr;
+			if (!a.heap.empty() && !b.heap.empty()) {
+				best = this->m_cmp(a.heap.peek(), b.heap.peek()) ? &a : &b;
+			} else if (!a.heap.empty()) {
+				best = &a;
+			} else if (!b.heap.empty()) {
+				best = &b;
+			}
+
+			if (best != nullptr) {
+				out = best->heap.pop_front();
+				this->m_size.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			b.lock.unlock();
+			a.lock.unlock();
+
+			if (best != nullptr) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
+
 /* Does what it says. Prints da vector */
 template <typename T>
 std::vector<T> print_vector(std::vector<T>&& v) {
 	std::cout << "[ ";
 	for (const T& item : v) {
-		std::cout << item << " ";	
+		std::cout << item << " ";
 	}
 	std::cout << "]" << std::endl;
 
 	return v;
 }
 
+/* Prints a view into some buffer (e.g. the one MHeap::expose() hands out) */
+template <typename T>
+void print_span(std::span<const T> v) {
+	std::cout << "[ ";
+	for (const T& item : v) {
+		std::cout << item << " ";
+	}
+	std::cout << "]" << std::endl;
+}
+
 std::vector<int> enumerate_vec(
 		const int start,
 	       	const int stop,
@@ -142,14 +1164,547 @@ std::vector<int> enumerate_vec(
 	return buff;
 };
 
-int main() {
+/** `size` uniformly random ints from a fixed seed so every structure sees the same input */
+std::vector<int> random_keys(size_t size, unsigned int seed = 42) {
+	std::mt19937 gen(seed);
+	std::uniform_int_distribution<int> dist(0, std::numeric_limits<int>::max());
+	std::vector<int> keys(size);
+	for (int& k : keys) {
+		k = dist(gen);
+	}
+
+	return keys;
+}
+
+/** Times `f` and prints it in the same format as the other snippets */
+template <typename F>
+long long time_ms(const char* label, F&& f) {
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::milliseconds;
+
+	const auto t1 = high_resolution_clock::now();
+	f();
+	const auto t2 = high_resolution_clock::now();
+
+	const auto ms_int = duration_cast<milliseconds>(t2 - t1);
+	std::cout << label << " took " << ms_int.count() << "ms" << std::endl;
+	return ms_int.count();
+}
+
+/** Push everything, then pop everything. The checksum keeps the optimizer honest. */
+void bench_push_pop(size_t n) {
+	const std::vector<int> keys = random_keys(n);
+	long long checksum = 0;
+
+	time_ms("std::priority_queue push+pop", [&]() {
+		std::priority_queue<int> pq;
+		for (int k : keys) pq.push(k);
+		while (!pq.empty()) { checksum += pq.top(); pq.pop(); }
+	});
+
+	time_ms("MHeap<HE_MAX, int, 2> push+pop", [&]() {
+		MHeap<HE_MAX, int, 2> heap;
+		heap.buffer.reserve(n);
+		for (int k : keys) heap.push(k);
+		while (!heap.empty()) checksum -= heap.pop_front();
+	});
+
+	time_ms("MHeap<HE_MAX, int, 4> push+pop", [&]() {
+		MHeap<HE_MAX, int, 4> heap;
+		heap.buffer.reserve(n);
+		for (int k : keys) heap.push(k);
+		while (!heap.empty()) checksum += heap.pop_front();
+	});
+
+	time_ms("IndexedMHeap<HE_MAX, int, 4> push+pop", [&]() {
+		IndexedMHeap<HE_MAX, int, 4> heap;
+		heap.reserve(n);
+		for (int k : keys) heap.push(k);
+		while (!heap.empty()) checksum -= heap.pop_front();
+	});
+
+	time_ms("IndexedMHeap<HE_MIN, int, 4> push+decrease_key+pop", [&]() {
+		IndexedMHeap<HE_MIN, int, 4> heap;
+		heap.reserve(n);
+		std::vector<HeapHandle> handles(n);
+		for (size_t i = 0; i < n; i++) handles[i] = heap.push(keys[i]);
+		for (size_t i = 0; i < n; i += 2) heap.decrease_key(handles[i], keys[i] / 2);
+		while (!heap.empty()) checksum += heap.pop_front();
+	});
+
+	std::cout << "checksum = " << checksum << std::endl;
+}
+
+/** A 64 byte queue entry, the size of the task records the scheduler pushes around */
+struct TaskRecord {
+	int priority;
+	int id;
+	char payload[56];
+
+	bool operator>(const TaskRecord& other) const { return this->priority > other.priority; }
+	bool operator<=(const TaskRecord& other) const { return this->priority <= other.priority; }
+};
+
+/** Same push-then-pop workload but with fat elements, where element moves dominate */
+void bench_task_records(size_t n) {
+	const std::vector<int> keys = random_keys(n);
+	long long checksum = 0;
+
+	time_ms("std::priority_queue<TaskRecord> push+pop", [&]() {
+		std::priority_queue<TaskRecord, std::vector<TaskRecord>, std::greater<>> pq;
+		for (size_t i = 0; i < n; i++) pq.push(TaskRecord { keys[i], (int) i, {} });
+		while (!pq.empty()) { checksum += pq.top().id; pq.pop(); }
+	});
+
+	time_ms("MHeap<HE_MIN, TaskRecord> emplace+pop", [&]() {
+		MHeap<HE_MIN, TaskRecord> heap;
+		heap.buffer.reserve(n);
+		for (size_t i = 0; i < n; i++) heap.emplace(TaskRecord { keys[i], (int) i, {} });
+		while (!heap.empty()) checksum -= heap.pop_front().id;
+	});
+
+	std::cout << "checksum = " << checksum << std::endl;
+}
+
+/** heap_order<HE_MAX> that also counts how often it is asked */
+struct CountingMaxOrder {
+	size_t* count;
+
+	bool operator()(int a, int b) const {
+		*count += 1;
+		return a >= b;
+	}
+};
+
+/** Sorts the same input with std::sort, std::make_heap + std::sort_heap and MHeap::heap_sort */
+void bench_sort_input(const char* input_name, const std::vector<int>& input) {
+	std::cout << "-- " << input_name << " input --" << std::endl;
+
+	std::vector<int> expected = input;
+	time_ms("std::sort", [&]() {
+		std::sort(expected.begin(), expected.end());
+	});
+
+	size_t std_comparisons = 0;
+	std::vector<int> v = input;
+	time_ms("std::make_heap + std::sort_heap", [&]() {
+		auto counting_less = [&std_comparisons](int a, int b) { std_comparisons += 1; return a < b; };
+		std::make_heap(v.begin(), v.end(), counting_less);
+		std::sort_heap(v.begin(), v.end(), counting_less);
+	});
+
+	size_t mheap_comparisons = 0;
+	v = input;
+	time_ms("MHeap<HE_MAX, int, 2>::heap_sort", [&]() {
+		MHeap<HE_MAX, int, 2, CountingMaxOrder>::heap_sort(v, CountingMaxOrder { &mheap_comparisons });
+	});
+	const bool binary_sorted = v == expected;
+
+	v = input;
+	time_ms("MHeap<HE_MAX, int, 4>::heap_sort", [&]() {
+		MHeap<HE_MAX, int, 4>::heap_sort(v);
+	});
+	const bool quaternary_sorted = v == expected;
+
+	std::cout << "comparisons: std heap " << std_comparisons << ", MHeap " << mheap_comparisons << std::endl;
+	std::cout << "sorted correctly: " << (binary_sorted && quaternary_sorted ? "yes" : "NO") << std::endl;
+}
+
+/** heap_sort on random, already sorted and duplicate-heavy inputs, then push_bulk against plain pushes */
+void bench_sorting(size_t n) {
+	const std::vector<int> random = random_keys(n);
+
+	std::vector<int> sorted = random;
+	std::sort(sorted.begin(), sorted.end());
+
+	std::vector<int> duplicates = random;
+	for (int& k : duplicates) {
+		k %= 16;
+	}
+
+	bench_sort_input("random", random);
+	bench_sort_input("sorted", sorted);
+	bench_sort_input("duplicate-heavy", duplicates);
+
+	std::cout << "-- half the keys in the heap, the other half arriving as one batch --" << std::endl;
+	const std::vector<int> front(random.begin(), random.begin() + n / 2);
+	const std::vector<int> batch(random.begin() + n / 2, random.end());
+	long long checksum = 0;
+
+	time_ms("MHeap<HE_MAX> push loop", [&]() {
+		std::vector<int> start = front;
+		MHeap<HE_MAX> heap(std::move(start));
+		for (int k : batch) heap.push(k);
+		checksum += heap.peek();
+	});
+
+	time_ms("MHeap<HE_MAX> push_bulk", [&]() {
+		std::vector<int> start = front;
+		MHeap<HE_MAX> heap(std::move(start));
+		heap.push_bulk(batch.begin(), batch.end());
+		checksum -= heap.peek();
+	});
+
+	std::cout << "checksum = " << checksum << std::endl;
+}
+
+/** Top-100 of n random ints: an unbounded MHeap, TopK one element at a time, TopK in batches, and
+ * four TopKs over quarters of the stream combined with merge() */
+void bench_topk(size_t n) {
+	constexpr size_t K = 100;
+	const std::vector<int> keys = random_keys(n);
+	std::vector<int> unbounded_top;
+	std::vector<int> scalar_top;
+	std::vector<int> batch_top;
+	std::vector<int> merged_top;
+
+	time_ms("MHeap<HE_MAX> push everything, pop K", [&]() {
+		MHeap<HE_MAX> heap;
+		for (int k : keys) heap.push(k);
+		for (size_t i = 0; i < K && !heap.empty(); i++) unbounded_top.push_back(heap.pop_front());
+	});
+
+	time_ms("TopK<HE_MAX> offer", [&]() {
+		TopK<HE_MAX> top(K);
+		for (int k : keys) top.offer(k);
+		scalar_top = top.sorted();
+	});
+
+	time_ms("TopK<HE_MAX> offer(span)", [&]() {
+		TopK<HE_MAX> top(K);
+		top.offer(std::span<const int>(keys));
+		batch_top = top.sorted();
+	});
+
+	time_ms("4 x TopK<HE_MAX> offer(span) + merge", [&]() {
+		std::vector<TopK<HE_MAX>> partials(4, TopK<HE_MAX>(K));
+		for (size_t t = 0; t < partials.size(); t++) {
+			const size_t begin = (t * n) / partials.size();
+			const size_t end = ((t + 1) * n) / partials.size();
+			partials[t].offer(std::span<const int>(keys.data() + begin, end - begin));
+		}
+		for (size_t t = 1; t < partials.size(); t++) partials[0].merge(partials[t]);
+		merged_top = partials[0].sorted();
+	});
+
+	const bool same = unbounded_top == scalar_top && scalar_top == batch_top && batch_top == merged_top;
+	std::cout << "same top " << K << ": " << (same ? "yes" : "NO") << " (avx2: " << (cpu_has_avx2() ? "yes" : "no") << ")" << std::endl;
+}
+
+/** A tentative distance in a shortest path search */
+struct DistNode {
+	uint32_t dist;
+	uint32_t node;
+
+	bool operator<=(const DistNode& other) const { return this->dist <= other.dist; }
+};
+
+/** RadixHeap key projection for DistNode */
+struct dist_of {
+	uint32_t operator()(const DistNode& d) const {
+		return d.dist;
+	}
+};
+
+/** A random directed graph in compressed sparse row form */
+struct CsrGraph {
+	std::vector<size_t> offsets;
+	std::vector<uint32_t> targets;
+	std::vector<uint32_t> weights;
+
+	static CsrGraph random(size_t nodes, size_t out_degree, uint32_t max_weight, unsigned int seed = 42) {
+		std::mt19937 gen(seed);
+		std::uniform_int_distribution<uint32_t> node_dist(0, (uint32_t) nodes - 1);
+		std::uniform_int_distribution<uint32_t> weight_dist(1, max_weight);
+
+		CsrGraph g;
+		g.offsets.resize(nodes + 1);
+		g.targets.resize(nodes * out_degree);
+		g.weights.resize(nodes * out_degree);
+		for (size_t v = 0; v < nodes; v++) {
+			g.offsets[v] = v * out_degree;
+			for (size_t e = v * out_degree; e < (v + 1) * out_degree; e++) {
+				g.targets[e] = node_dist(gen);
+				g.weights[e] = weight_dist(gen);
+			}
+		}
+		g.offsets[nodes] = nodes * out_degree;
+		return g;
+	}
+};
+
+/** Lazy-deletion Dijkstra from node 0 that works with any queue exposing push/pop_front/empty */
+template <typename Queue>
+std::vector<uint32_t> dijkstra(const CsrGraph& g, Queue& queue) {
+	const size_t nodes = g.offsets.size() - 1;
+	std::vector<uint32_t> dist(nodes, std::numeric_limits<uint32_t>::max());
+	dist[0] = 0;
+	queue.push(DistNode { 0, 0 });
+
+	while (!queue.empty()) {
+		const DistNode top = queue.pop_front();
+		if (top.dist != dist[top.node]) {
+			continue;
+		}
+
+		for (size_t e = g.offsets[top.node]; e < g.offsets[top.node + 1]; e++) {
+			const uint32_t candidate = top.dist + g.weights[e];
+			if (candidate < dist[g.targets[e]]) {
+				dist[g.targets[e]] = candidate;
+				queue.push(DistNode { candidate, g.targets[e] });
+			}
+		}
+	}
+
+	return dist;
+}
+
+/** Shortest paths on a random graph with `nodes` nodes and 8 edges per node */
+void bench_dijkstra(size_t nodes) {
+	const CsrGraph g = CsrGraph::random(nodes, 8, 1000);
+	std::vector<uint32_t> binary_dist;
+	std::vector<uint32_t> quad_dist;
+	std::vector<uint32_t> radix_dist;
+
+	time_ms("Dijkstra with MHeap<HE_MIN, DistNode>", [&]() {
+		MHeap<HE_MIN, DistNode> queue;
+		binary_dist = dijkstra(g, queue);
+	});
+
+	time_ms("Dijkstra with MHeap<HE_MIN, DistNode, 4>", [&]() {
+		MHeap<HE_MIN, DistNode, 4> queue;
+		quad_dist = dijkstra(g, queue);
+	});
+
+	time_ms("Dijkstra with RadixHeap<DistNode>", [&]() {
+		RadixHeap<DistNode, dist_of> queue;
+		radix_dist = dijkstra(g, queue);
+	});
+
+	const bool same = binary_dist == quad_dist && quad_dist == radix_dist;
+	std::cout << "same distances: " << (same ? "yes" : "NO") << std::endl;
+}
+
+/** Writes `total` random ints as `k` sorted run files under `dir` and returns their paths */
+std::vector<std::string> write_sorted_runs(const std::filesystem::path& dir, size_t k, size_t total) {
+	std::vector<int> keys = random_keys(total, (unsigned int) k);
+	std::vector<std::string> paths;
+
+	for (size_t r = 0; r < k; r++) {
+		const auto begin = keys.begin() + (r * total) / k;
+		const auto end = keys.begin() + ((r + 1) * total) / k;
+		std::sort(begin, end);
+
+		const std::string path = (dir / ("run_" + std::to_string(r) + ".bin")).string();
+		RunWriter<int> writer(path, 1 << 16);
+		for (auto it = begin; it != end; it++) {
+			writer.push(*it);
+		}
+		paths.push_back(path);
+	}
+
+	return paths;
+}
+
+/** k-way merges `total` ints spread over k = 2..1024 run files and reports the throughput. The runs
+ * were just written, so they are likely still in the page cache: this measures the merge itself. */
+void bench_kway_merge(size_t total) {
+	std::cout << "\n[k-way merge of " << total << " ints]" << std::endl;
+	std::cout << "==============================" << std::endl;
+
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "bheap_runs";
+	constexpr size_t read_ahead_budget = 256u << 20;
+
+	for (size_t k = 2; k <= 1024; k *= 2) {
+		std::filesystem::create_directories(dir);
+		const std::vector<std::string> runs = write_sorted_runs(dir, k, total);
+		const std::string out_path = (dir / "merged.bin").string();
+		const size_t buffer_bytes = std::max<size_t>(64u << 10, read_ahead_budget / k);
+
+		size_t written = 0;
+		const std::string label = "merge of k = " + std::to_string(k) + " runs";
+		const long long ms = time_ms(label.c_str(), [&]() {
+			written = merge_runs<HE_MIN>(runs, out_path, buffer_bytes);
+		});
+
+		bool sorted = written == total;
+		{
+			std::vector<RunReader<int>> merged;
+			merged.emplace_back(out_path, 1 << 16);
+			int prev = std::numeric_limits<int>::min();
+			for (; !merged[0].exhausted(); merged[0].advance()) {
+				sorted = sorted && prev <= merged[0].current();
+				prev = merged[0].current();
+			}
+		}
+
+		const double megabytes = (double) (total * sizeof(int)) / (1 << 20);
+		std::cout << "  " << megabytes / (std::max<long long>(ms, 1) / 1000.0) << " MB/s, sorted: " << (sorted ? "yes" : "NO") << std::endl;
+		std::filesystem::remove_all(dir);
+	}
+}
+
+/** Fenwick tree over the keys 0..n-1 that tracks which of them are still queued */
+struct PresenceCounter {
+	std::vector<int> tree;
+
+	PresenceCounter(size_t n) : tree(n + 1, 0) {
+		for (size_t k = 0; k < n; k++) {
+			this->add(k, 1);
+		}
+	}
+
+	void add(size_t key, int delta) {
+		for (size_t i = key + 1; i < this->tree.size(); i += i & (~i + 1)) {
+			this->tree[i] += delta;
+		}
+	}
+
+	/** How many queued keys are strictly smaller than `key` */
+	size_t count_below(size_t key) const {
+		size_t total = 0;
+		for (size_t i = key; i > 0; i -= i & (~i + 1)) {
+			total += this->tree[i];
+		}
+		return total;
+	}
+};
+
+/** Runs `body(thread_index)` on `threads` threads and waits for all of them */
+template <typename F>
+void run_on_threads(size_t threads, F&& body) {
+	std::vector<std::thread> pool;
+	for (size_t t = 0; t < threads; t++) {
+		pool.emplace_back(body, t);
+	}
+	for (std::thread& worker : pool) {
+		worker.join();
+	}
+}
+
+/** Throughput of a 50/50 push/pop mix on a MultiQueue vs. one MHeap behind a mutex, followed by
+ * the rank error of a MultiQueue drained concurrently. A pop's rank error is how many better keys
+ * were still queued when it happened; the replay orders pops by a stamp taken right after each pop. */
+void bench_multiqueue(size_t max_threads, size_t ops_per_thread) {
+	std::cout << "\n[MultiQueue, " << ops_per_thread << " ops per thread]" << std::endl;
+	std::cout << "==============================" << std::endl;
+	const std::vector<int> keys = random_keys(ops_per_thread);
+
+	std::vector<size_t> thread_counts;
+	for (size_t threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+
+	for (size_t threads : thread_counts) {
+		std::cout << "-- " << threads << " thread(s) --" << std::endl;
+		const double total_ops = static_cast<double>(threads * ops_per_thread);
+
+		{
+			MultiQueue<HE_MIN> queue(threads);
+			for (int k : keys) queue.push(k);
+
+			const long long ms = time_ms("MultiQueue push/pop mix", [&]() {
+				run_on_threads(threads, [&](size_t t) {
+					int out;
+					for (size_t i = 0; i < ops_per_thread; i++) {
+						if (i & 1) queue.try_pop(out);
+						else queue.push(keys[(i + t) % keys.size()]);
+					}
+				});
+			});
+			std::cout << "  " << total_ops / std::max<long long>(ms, 1) / 1000.0 << " Mops/s" << std::endl;
+		}
+
+		{
+			std::mutex lock;
+			MHeap<HE_MIN> heap(std::vector<int>(keys.begin(), keys.end()));
+
+			const long long ms = time_ms("MHeap + std::mutex push/pop mix", [&]() {
+				run_on_threads(threads, [&](size_t t) {
+					for (size_t i = 0; i < ops_per_thread; i++) {
+						std::lock_guard<std::mutex> guard(lock);
+						if (i & 1) { if (!heap.empty()) heap.pop_front(); }
+						else heap.push(keys[(i + t) % keys.size()]);
+					}
+				});
+			});
+			std::cout << "  " << total_ops / std::max<long long>(ms, 1) / 1000.0 << " Mops/s" << std::endl;
+		}
+
+		{
+			const size_t n = ops_per_thread;
+			MultiQueue<HE_MIN> queue(threads);
+			std::vector<int> distinct(n);
+			for (size_t k = 0; k < n; k++) distinct[k] = (int) k;
+			std::shuffle(distinct.begin(), distinct.end(), std::mt19937(7));
+			for (int k : distinct) queue.push(k);
+
+			std::atomic<uint64_t> clock(0);
+			std::vector<std::vector<std::pair<uint64_t, int>>> logs(threads);
+			run_on_threads(threads, [&](size_t t) {
+				int out;
+				while (queue.try_pop(out)) {
+					logs[t].push_back({ clock.fetch_add(1, std::memory_order_relaxed), out });
+				}
+			});
+
+			std::vector<std::pair<uint64_t, int>> pops;
+			for (const auto& log : logs) pops.insert(pops.end(), log.begin(), log.end());
+			std::sort(pops.begin(), pops.end());
+
+			PresenceCounter queued(n);
+			double total_rank = 0;
+			size_t max_rank = 0;
+			for (const auto& [stamp, key] : pops) {
+				const size_t rank = queued.count_below((size_t) key);
+				total_rank += (double) rank;
+				max_rank = std::max(max_rank, rank);
+				queued.add((size_t) key, -1);
+			}
+
+			std::cout << "MultiQueue rank error over " << pops.size() << " pops (" << queue.shards() << " shards): mean "
+				<< total_rank / std::max<size_t>(pops.size(), 1) << ", max " << max_rank << std::endl;
+		}
+	}
+}
+
+/** Runs the heap benchmarks for n = 10^3 .. 10^max_exponent, then the MultiQueue
+ * benchmark for 1 .. max_threads threads */
+void run_benchmarks(int max_exponent, size_t max_threads) {
+	size_t n = 1000;
+	for (int e = 3; e <= max_exponent; e++) {
+		std::cout << "\n[n = " << n << "]" << std::endl;
+		std::cout << "==============================" << std::endl;
+		bench_push_pop(n);
+		bench_task_records(n);
+		bench_sorting(n);
+		bench_topk(n);
+		if (e <= 7) {
+			bench_dijkstra(n);
+		}
+		n *= 10;
+	}
+
+	bench_multiqueue(max_threads, 1'000'000);
+	bench_kway_merge(size_t(1) << 26);
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "bench") {
+		const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+		run_benchmarks(argc > 2 ? std::atoi(argv[2]) : 8, argc > 3 ? (size_t) std::atoi(argv[3]) : hardware_threads);
+		return EXIT_SUCCESS;
+	}
+
 	std::cout << "PRIOR: ";
 	std::vector<int> f = print_vector(enumerate_vec(10, 30));
 	constexpr HeapExtrema EXTREMA = HeapExtrema::HE_MAX;
 	MHeap<EXTREMA> my_heap(std::move(f));
 
 	std::cout << "POST: ";
-	f = print_vector(my_heap.expose());
+	print_span(my_heap.expose());
 
 	while (!my_heap.empty()) {
 		int top = my_heap.pop_front();
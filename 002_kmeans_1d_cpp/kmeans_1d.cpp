@@ -5,6 +5,35 @@
 #include <array>
 #include <optional>
 #include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include <thread>
+#include <barrier>
+#include <type_traits>
+#include <random>
+#include <span>
+#include <cstdio>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KMEANS_POSIX_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define KMEANS_POSIX_MMAP 0
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KMEANS_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define KMEANS_X86_SIMD 0
+#endif
 
 /** DUMB Branchless programming shit. Just use a ternary gang */
 template<typename T>
@@ -122,13 +151,37 @@ std::vector<IllNode<T>> illnode_wrap_vec(std::vector<T>&& v) {
     return w;
 }
 
+/** A K(Means)E(ngine) tag selecting Lloyd iterations over intrusive linked list clusters */
+struct LloydKE {};
+
+/** A K(Means)E(ngine) tag selecting the exact, globally optimal clustering via dynamic programming */
+struct OptimalKE {};
+
+/** A K(Means)E(ngine) tag selecting Lloyd iterations over sorted data, with clusters as index ranges */
+struct SortedRangeKE {};
+
+/** A K(Means)E(ngine) tag selecting weighted Lloyd iterations over a (value, count) histogram of the data */
+struct HistogramKE {};
+
+/** A K(Means)E(ngine) tag selecting Lloyd iterations split across a pool of threads */
+struct ParallelLloydKE {};
+
+/** Smallest unsigned type that can name every one of `clusters` clusters, for per-item label arrays */
+template <size_t clusters>
+using cluster_label_t = std::conditional_t<(clusters <= 256), uint8_t, std::conditional_t<(clusters <= 65536), uint16_t, uint32_t>>;
+
+/** Actual KMeansClustering but just for 1d data. `Engine` picks how the clusters are found; every
+ * engine exposes the same constructor, collect_clusters and get_centroid. */
+template <size_t clusters, typename Engine = LloydKE>
+class KMeansClustering;
+
 // Most of the shit above did not matter LMAOOOOOOOO
 // Main idea here? Linked List based centroid lists
 // `data` holds the I(ntrusive)l(inked)l(ist)Nodes, which are chained together
 
-/** Actual KMeansClustering but just for 1d data. */
+/** Lloyd's algorithm, the original engine */
 template <size_t clusters>
-class KMeansClustering {
+class KMeansClustering<clusters, LloydKE> {
 private:
     std::array<int, clusters> centroids;
     std::array<std::optional<size_t>, clusters> heads;
@@ -153,7 +206,9 @@ private:
         for (size_t i = 0; i < clusters; i++) {
             const int centroid_value = centroids[i];
             int distance = std::abs(centroid_value - item);
-            min_distance = branchless_select(distance <= min_distance.elem, IndexWrapper<int>::wrap(i, std::move(distance)), min_distance);
+            const bool closer = distance <= min_distance.elem;
+            IndexWrapper<int> candidate = IndexWrapper<int>::wrap(i, std::move(distance));
+            min_distance = branchless_select(closer, candidate, min_distance);
         }
 
         return min_distance.index;
@@ -193,14 +248,14 @@ private:
     int average_cluster(IllNode<int>& cluster_head) {
         IllNode<int>* cur_node = &cluster_head;
         size_t cluster_length = 1;
-        int sum = cur_node->item;
+        long long sum = cur_node->item;
         while (cur_node->links[1]) {
             cur_node = &this->data[*cur_node->links[1]];
             sum += cur_node->item;
             cluster_length += 1;
         }
 
-        return sum / (int) cluster_length;
+        return (int) (sum / (long long) cluster_length);
     }
 
     /** Updates the centroids */
@@ -309,7 +364,1335 @@ public:
     }
 };
 
-int main() {
+/** Exact 1D k-means. In one dimension an optimal clustering always splits the sorted data into
+ * contiguous runs, and copies of the same value never need to be split up, so the data is sorted,
+ * collapsed into (value, count) pairs and the best split points are found with dynamic programming:
+ *
+ *     cost[m][i] = min over j of cost[m - 1][j] + SSE(distinct values [j, i))
+ *
+ * The best j never moves left as i grows, so each row is filled by divide and conquer in
+ * O(d log d) where d is the number of distinct values, O(k d log d) overall after the sort. */
+template <size_t clusters>
+class KMeansClustering<clusters, OptimalKE> {
+private:
+    std::array<int, clusters> centroids;
+    std::array<size_t, clusters + 1> bounds; // cluster c holds data[bounds[c], bounds[c + 1])
+    std::vector<int> data;
+
+    // Per distinct value prefix sums. Values are centered on the mean before squaring, which keeps
+    // the SSE = sum(x^2) - sum(x)^2 / n subtraction from eating all the precision.
+    std::vector<int> values;
+    std::vector<size_t> count_prefix;
+    std::vector<double> sum_prefix;
+    std::vector<double> square_prefix;
+
+    /** Sum of squared distances to the mean of the distinct values [j, i) */
+    double sse(const size_t j, const size_t i) const {
+        const double n = (double) (this->count_prefix[i] - this->count_prefix[j]);
+        const double sum = this->sum_prefix[i] - this->sum_prefix[j];
+        const double squares = this->square_prefix[i] - this->square_prefix[j];
+        return std::max(0.0, squares - sum * sum / n);
+    }
+
+    /** Collapses the (sorted) data into distinct values and builds the prefix sums over them */
+    void build_prefixes() {
+        long double total = 0;
+        for (const int item : this->data) {
+            total += item;
+        }
+        const double center = this->data.empty() ? 0.0 : (double) (total / this->data.size());
+
+        this->count_prefix.push_back(0);
+        this->sum_prefix.push_back(0.0);
+        this->square_prefix.push_back(0.0);
+
+        size_t i = 0;
+        while (i < this->data.size()) {
+            const int value = this->data[i];
+            size_t run = 0;
+            while (i < this->data.size() && this->data[i] == value) {
+                run += 1;
+                i += 1;
+            }
+
+            const double centered = (double) value - center;
+            this->values.push_back(value);
+            this->count_prefix.push_back(this->count_prefix.back() + run);
+            this->sum_prefix.push_back(this->sum_prefix.back() + centered * run);
+            this->square_prefix.push_back(this->square_prefix.back() + centered * centered * run);
+        }
+    }
+
+    /** Fills cur[lo..hi] from prev, knowing the best split for those entries lies in [opt_lo, opt_hi] */
+    void solve_row(const std::vector<double>& prev, std::vector<double>& cur, std::vector<uint32_t>& split,
+                   size_t lo, size_t hi, size_t opt_lo, size_t opt_hi) const {
+        while (lo <= hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            double best = std::numeric_limits<double>::infinity();
+            size_t best_j = opt_lo;
+
+            const size_t last_j = std::min(mid - 1, opt_hi);
+            for (size_t j = opt_lo; j <= last_j; j++) {
+                const double candidate = prev[j] + this->sse(j, mid);
+                if (candidate < best) {
+                    best = candidate;
+                    best_j = j;
+                }
+            }
+
+            cur[mid] = best;
+            split[mid] = (uint32_t) best_j;
+
+            // recurse into the smaller half, loop on the other to keep the stack shallow
+            if (mid - lo < hi - mid) {
+                if (mid > lo) {
+                    this->solve_row(prev, cur, split, lo, mid - 1, opt_lo, best_j);
+                }
+                lo = mid + 1;
+                opt_lo = best_j;
+            } else {
+                this->solve_row(prev, cur, split, mid + 1, hi, best_j, opt_hi);
+                if (mid == lo) {
+                    break;
+                }
+                hi = mid - 1;
+                opt_hi = best_j;
+            }
+        }
+    }
+
+    /** Runs the DP and turns the optimal split points back into centroids and data ranges */
+    void fit() {
+        const size_t d = this->values.size();
+        const size_t used = std::min(clusters, d);
+
+        this->bounds.fill(this->data.size());
+        this->bounds[0] = 0;
+        this->centroids.fill(0);
+        if (used == 0) {
+            return;
+        }
+
+        // splits[m][i]: where the last of m + 1 clusters starts when covering the first i distinct values
+        std::vector<std::vector<uint32_t>> splits(used, std::vector<uint32_t>(d + 1, 0));
+        std::vector<double> prev(d + 1, std::numeric_limits<double>::infinity());
+        std::vector<double> cur(d + 1, std::numeric_limits<double>::infinity());
+
+        for (size_t i = 1; i <= d; i++) {
+            prev[i] = this->sse(0, i);
+        }
+
+        for (size_t m = 1; m < used; m++) {
+            std::fill(cur.begin(), cur.end(), std::numeric_limits<double>::infinity());
+            this->solve_row(prev, cur, splits[m], m + 1, d, m, d - 1);
+            std::swap(prev, cur);
+        }
+
+        // walk the split points back from the full range
+        std::array<size_t, clusters + 1> distinct_bounds = {};
+        distinct_bounds[used] = d;
+        for (size_t m = used; m-- > 1;) {
+            distinct_bounds[m] = splits[m][distinct_bounds[m + 1]];
+        }
+
+        for (size_t c = 0; c < used; c++) {
+            const size_t begin = this->count_prefix[distinct_bounds[c]];
+            const size_t end = this->count_prefix[distinct_bounds[c + 1]];
+            this->bounds[c] = begin;
+
+            long long sum = 0;
+            for (size_t v = distinct_bounds[c]; v < distinct_bounds[c + 1]; v++) {
+                sum += (long long) this->values[v] * (long long) (this->count_prefix[v + 1] - this->count_prefix[v]);
+            }
+            this->centroids[c] = (int) (sum / (long long) (end - begin));
+        }
+
+        // fewer distinct values than clusters: the leftover clusters stay empty at the last centroid
+        for (size_t c = used; c < clusters; c++) {
+            this->centroids[c] = this->centroids[used - 1];
+        }
+    }
+
+public:
+    KMeansClustering(std::vector<int>&& data): centroids({}), bounds({}), data(std::move(data)) {
+        std::sort(this->data.begin(), this->data.end());
+        this->build_prefixes();
+        this->fit();
+    }
+
+    /** Collects the clusters as an array of std::vectors */
+    std::array<std::vector<int>, clusters> collect_clusters() {
+        std::array<std::vector<int>, clusters> out = {};
+        for (size_t c = 0; c < clusters; c++) {
+            out[c].assign(this->data.begin() + this->bounds[c], this->data.begin() + this->bounds[c + 1]);
+        }
+
+        return out;
+    }
+
+    /** Get the centroid of cluster index i */
+    int get_centroid(size_t i) {
+        return this->centroids[i];
+    }
+};
+
+/** Lloyd's algorithm on sorted data. In 1D every cluster of a nearest-centroid assignment is a
+ * contiguous run of the sorted data, cut where the data crosses the midpoint between two neighbouring
+ * centroids. So the data is sorted once, clusters are kept as [begin, end) ranges, each iteration
+ * finds the k - 1 cuts by binary search and averages every range from a prefix sum: O(k log n) per
+ * iteration instead of O(n k), and no per-element links to chase. Seeded like LloydKE.
+ * A value exactly between two centroids goes to the lower-valued one, while LloydKE (keeping the last
+ * centroid with distance <= the best) gives it to the higher cluster index, so on tied inputs the two
+ * can settle on different, equally good, fixed points. */
+template <size_t clusters>
+class KMeansClustering<clusters, SortedRangeKE> {
+private:
+    std::array<int, clusters> centroids;
+    std::array<size_t, clusters> begins; // cluster c holds data[begins[c], ends[c])
+    std::array<size_t, clusters> ends;
+    std::vector<int> data;
+    std::vector<long long> prefix; // prefix[i] = data[0] + ... + data[i - 1]
+
+    /** Largest value that is still at least as close to `lower` as to `upper` (lower <= upper) */
+    static long long last_value_of_lower(const int lower, const int upper) {
+        const long long sum = (long long) lower + (long long) upper;
+        return sum >= 0 ? sum / 2 : -((-sum + 1) / 2);
+    }
+
+    /** Recomputes every cluster's range from the current centroids */
+    void assign_ranges() {
+        std::array<size_t, clusters> order;
+        for (size_t c = 0; c < clusters; c++) {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return this->centroids[a] < this->centroids[b];
+        });
+
+        size_t position = 0;
+        for (size_t r = 0; r < clusters; r++) {
+            const size_t c = order[r];
+            size_t end = this->data.size();
+            if (r + 1 < clusters) {
+                const long long cut = last_value_of_lower(this->centroids[c], this->centroids[order[r + 1]]);
+                end = std::upper_bound(this->data.begin() + position, this->data.end(), cut,
+                    [](long long value, int item) { return value < item; }) - this->data.begin();
+            }
+
+            this->begins[c] = position;
+            this->ends[c] = end;
+            position = end;
+        }
+    }
+
+    /** Averages every cluster's range, keeping the old centroid for empty clusters */
+    std::array<int, clusters> update_centroids() const {
+        std::array<int, clusters> new_centroids = this->centroids;
+        for (size_t c = 0; c < clusters; c++) {
+            const size_t length = this->ends[c] - this->begins[c];
+            if (length > 0) {
+                const long long sum = this->prefix[this->ends[c]] - this->prefix[this->begins[c]];
+                new_centroids[c] = (int) (sum / (long long) length);
+            }
+        }
+
+        return new_centroids;
+    }
+
+public:
+    KMeansClustering(std::vector<int>&& data): centroids({}), begins({}), ends({}), data(std::move(data)) {
+        // same seeding as LloydKE: the first `clusters` items, before sorting
+        for (size_t c = 0; c < clusters && c < this->data.size(); c++) {
+            this->centroids[c] = this->data[c];
+        }
+
+        std::sort(this->data.begin(), this->data.end());
+        this->prefix.resize(this->data.size() + 1);
+        this->prefix[0] = 0;
+        for (size_t i = 0; i < this->data.size(); i++) {
+            this->prefix[i + 1] = this->prefix[i] + this->data[i];
+        }
+
+        this->assign_ranges();
+        std::array<int, clusters> new_centroids = this->update_centroids();
+        while (new_centroids != this->centroids) {
+            this->centroids = new_centroids;
+            this->assign_ranges();
+            new_centroids = this->update_centroids();
+        }
+    }
+
+    /** Collects the clusters as an array of std::vectors */
+    std::array<std::vector<int>, clusters> collect_clusters() {
+        std::array<std::vector<int>, clusters> out = {};
+        for (size_t c = 0; c < clusters; c++) {
+            out[c].assign(this->data.begin() + this->begins[c], this->data.begin() + this->ends[c]);
+        }
+
+        return out;
+    }
+
+    /** Get the centroid of cluster index i */
+    int get_centroid(size_t i) {
+        return this->centroids[i];
+    }
+};
+
+/** Lloyd's algorithm over a histogram of the data. A counting pass first folds the input into sorted
+ * (value, count) pairs; every iteration then assigns and averages the distinct values only, with the
+ * counts as weights. Per-iteration cost depends on the cardinality of the data instead of n. Seeding,
+ * tie breaking and the truncated averages match LloydKE, so both converge to the same centroids.
+ * Members are only expanded back out of the histogram when collect_clusters is called. */
+template <size_t clusters>
+class KMeansClustering<clusters, HistogramKE> {
+private:
+    std::array<int, clusters> centroids;
+    std::vector<int> values;          // distinct values, ascending
+    std::vector<size_t> counts;       // counts[i] = occurrences of values[i]
+    std::vector<uint32_t> labels;     // labels[i] = cluster of values[i]
+
+    /** Value ranges at most this many times the input size are counted into a dense table,
+     * anything wider is sorted and run-length encoded instead */
+    static constexpr size_t DENSE_RANGE_FACTOR = 4;
+
+    /** Folds `data` into the sorted (value, count) histogram */
+    void count_values(std::vector<int>& data) {
+        if (data.empty()) {
+            return;
+        }
+
+        const auto [min_it, max_it] = std::minmax_element(data.begin(), data.end());
+        const int low = *min_it;
+        const unsigned long long range = (unsigned long long) ((long long) *max_it - (long long) low) + 1;
+
+        if (range <= DENSE_RANGE_FACTOR * data.size()) {
+            std::vector<size_t> table(range, 0);
+            for (const int item : data) {
+                table[(size_t) ((long long) item - low)] += 1;
+            }
+
+            for (size_t offset = 0; offset < range; offset++) {
+                if (table[offset] > 0) {
+                    this->values.push_back((int) ((long long) low + (long long) offset));
+                    this->counts.push_back(table[offset]);
+                }
+            }
+        } else {
+            std::sort(data.begin(), data.end());
+            for (size_t i = 0; i < data.size();) {
+                size_t run = i + 1;
+                while (run < data.size() && data[run] == data[i]) {
+                    run += 1;
+                }
+
+                this->values.push_back(data[i]);
+                this->counts.push_back(run - i);
+                i = run;
+            }
+        }
+    }
+
+    /** Given some int `item` returns the nearest cluster to said item, ties going the same way as LloydKE */
+    size_t nearest_centroid(const int item) const {
+        size_t best = 0;
+        long long best_distance = std::numeric_limits<long long>::max();
+        for (size_t c = 0; c < clusters; c++) {
+            const long long distance = std::abs((long long) this->centroids[c] - (long long) item);
+            const bool closer = distance <= best_distance;
+            best = closer ? c : best;
+            best_distance = closer ? distance : best_distance;
+        }
+
+        return best;
+    }
+
+    /** Labels every distinct value with its nearest centroid and returns the weighted averages,
+     * keeping the old centroid for empty clusters */
+    std::array<int, clusters> assign_and_average() {
+        std::array<long long, clusters> sums = {};
+        std::array<size_t, clusters> sizes = {};
+        for (size_t i = 0; i < this->values.size(); i++) {
+            const size_t c = this->nearest_centroid(this->values[i]);
+            this->labels[i] = (uint32_t) c;
+            sums[c] += (long long) this->values[i] * (long long) this->counts[i];
+            sizes[c] += this->counts[i];
+        }
+
+        std::array<int, clusters> new_centroids = this->centroids;
+        for (size_t c = 0; c < clusters; c++) {
+            if (sizes[c] > 0) {
+                new_centroids[c] = (int) (sums[c] / (long long) sizes[c]);
+            }
+        }
+
+        return new_centroids;
+    }
+
+public:
+    KMeansClustering(std::vector<int>&& data): centroids({}) {
+        // same seeding as LloydKE: the first `clusters` items of the input
+        for (size_t c = 0; c < clusters && c < data.size(); c++) {
+            this->centroids[c] = data[c];
+        }
+
+        this->count_values(data);
+        this->labels.resize(this->values.size());
+
+        std::array<int, clusters> new_centroids = this->assign_and_average();
+        while (new_centroids != this->centroids) {
+            this->centroids = new_centroids;
+            new_centroids = this->assign_and_average();
+        }
+    }
+
+    /** Number of distinct values the iterations ran over */
+    size_t cardinality() const {
+        return this->values.size();
+    }
+
+    /** Number of members in cluster index i, without expanding them */
+    size_t cluster_size(size_t i) const {
+        size_t size = 0;
+        for (size_t v = 0; v < this->values.size(); v++) {
+            size += this->labels[v] == i ? this->counts[v] : 0;
+        }
+
+        return size;
+    }
+
+    /** Collects the clusters as an array of std::vectors, expanding every value `count` times */
+    std::array<std::vector<int>, clusters> collect_clusters() {
+        std::array<std::vector<int>, clusters> out = {};
+        for (size_t v = 0; v < this->values.size(); v++) {
+            out[this->labels[v]].insert(out[this->labels[v]].end(), this->counts[v], this->values[v]);
+        }
+
+        return out;
+    }
+
+    /** Get the centroid of cluster index i */
+    int get_centroid(size_t i) {
+        return this->centroids[i];
+    }
+};
+
+/** Lloyd's algorithm split across a pool of threads. The data stays flat with one label per item; each
+ * thread owns a contiguous slice and accumulates per-cluster (sum, count) partials into its own cache
+ * line padded block, so nothing is shared while assigning. At the barrier that ends an iteration the
+ * partials are reduced in thread order, which (the sums being exact integers) gives bit-for-bit the
+ * centroids of the serial LloydKE, including its seeding, tie breaking and empty cluster handling. */
+template <size_t clusters>
+class KMeansClustering<clusters, ParallelLloydKE> {
+private:
+    /** One thread's partials for an iteration. Aligned so no two threads ever write to the same line. */
+    struct alignas(64) Partials {
+        std::array<long long, clusters> sums;
+        std::array<size_t, clusters> counts;
+    };
+
+    std::array<int, clusters> centroids;
+    std::vector<int> data;
+    std::vector<cluster_label_t<clusters>> labels;
+    size_t iterations;
+
+    /** Given some int `item` returns the nearest cluster to said item, ties going the same way as LloydKE */
+    size_t nearest_centroid(const int item) const {
+        size_t best = 0;
+        long long best_distance = std::numeric_limits<long long>::max();
+        for (size_t c = 0; c < clusters; c++) {
+            const long long distance = std::abs((long long) this->centroids[c] - (long long) item);
+            const bool closer = distance <= best_distance;
+            best = closer ? c : best;
+            best_distance = closer ? distance : best_distance;
+        }
+
+        return best;
+    }
+
+    /** Labels data[begin, end) with the current centroids and fills `out` with that slice's partials */
+    void assign_slice(const size_t begin, const size_t end, Partials& out) {
+        Partials local = {};
+        for (size_t i = begin; i < end; i++) {
+            const size_t c = this->nearest_centroid(this->data[i]);
+            this->labels[i] = (cluster_label_t<clusters>) c;
+            local.sums[c] += this->data[i];
+            local.counts[c] += 1;
+        }
+
+        out = local;
+    }
+
+    /** Folds the partials in thread order into the next centroids, keeping the old one for empty clusters */
+    std::array<int, clusters> reduce(const std::vector<Partials>& partials) const {
+        std::array<long long, clusters> sums = {};
+        std::array<size_t, clusters> counts = {};
+        for (const Partials& p : partials) {
+            for (size_t c = 0; c < clusters; c++) {
+                sums[c] += p.sums[c];
+                counts[c] += p.counts[c];
+            }
+        }
+
+        std::array<int, clusters> new_centroids = this->centroids;
+        for (size_t c = 0; c < clusters; c++) {
+            if (counts[c] > 0) {
+                new_centroids[c] = (int) (sums[c] / (long long) counts[c]);
+            }
+        }
+
+        return new_centroids;
+    }
+
+public:
+    /** Clusters `data` on `threads` threads (the calling thread included) */
+    KMeansClustering(std::vector<int>&& data, size_t threads = std::thread::hardware_concurrency())
+        : centroids({}), data(std::move(data)), iterations(0) {
+        // same seeding as LloydKE: the first `clusters` items
+        for (size_t c = 0; c < clusters && c < this->data.size(); c++) {
+            this->centroids[c] = this->data[c];
+        }
+
+        const size_t n = this->data.size();
+        threads = std::max<size_t>(1, std::min(threads, std::max<size_t>(1, n)));
+        this->labels.resize(n);
+
+        std::vector<Partials> partials(threads);
+        bool converged = false;
+
+        // runs on exactly one thread once all of them have arrived, before any is released
+        auto end_iteration = [&]() noexcept {
+            const std::array<int, clusters> new_centroids = this->reduce(partials);
+            this->iterations += 1;
+            converged = new_centroids == this->centroids;
+            this->centroids = new_centroids;
+        };
+        std::barrier sync((std::ptrdiff_t) threads, end_iteration);
+
+        auto worker = [&](const size_t t) {
+            const size_t begin = n * t / threads;
+            const size_t end = n * (t + 1) / threads;
+            do {
+                this->assign_slice(begin, end, partials[t]);
+                sync.arrive_and_wait();
+            } while (!converged);
+        };
+
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++) {
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        for (std::thread& t : pool) {
+            t.join();
+        }
+    }
+
+    /** Number of assign + reduce rounds it took to converge */
+    size_t iteration_count() const {
+        return this->iterations;
+    }
+
+    /** Collects the clusters as an array of std::vectors, members in input order */
+    std::array<std::vector<int>, clusters> collect_clusters() {
+        std::array<std::vector<int>, clusters> out = {};
+        for (size_t i = 0; i < this->data.size(); i++) {
+            out[this->labels[i]].push_back(this->data[i]);
+        }
+
+        return out;
+    }
+
+    /** Get the centroid of cluster index i */
+    int get_centroid(size_t i) {
+        return this->centroids[i];
+    }
+};
+
+/** What one iteration of DynamicKMeansClustering did */
+struct KMeansIterationStats {
+    size_t reexamined; // points whose bounds could not rule out a closer centroid, so all k distances were computed
+    size_t reassigned; // points that ended the iteration in a different cluster
+    double ms;         // wall time of the iteration
+};
+
+/** K-means for 1d data with k picked at runtime. Centroids are seeded with k-means++ (D^2 sampling,
+ * reproducible through `seed`) and iterated with Hamerly's bounds: every point keeps an upper bound on
+ * the distance to its own centroid and a lower bound on the distance to any other one. A point only
+ * runs the k distance loop when those bounds, loosened by how far the centroids moved, no longer prove
+ * its assignment, which after the first few iterations is a small fraction of the data.
+ * Cluster sums are kept as exact integers and centroids are the means they give; get_centroid truncates
+ * them like the fixed-k engines do. */
+class DynamicKMeansClustering {
+private:
+    std::vector<double> centroids;
+    std::vector<int> data;
+    std::vector<uint32_t> labels;
+    std::vector<double> upper;    // upper[i] >= |data[i] - centroids[labels[i]]|
+    std::vector<double> lower;    // lower[i] <= distance from data[i] to any other centroid
+    std::vector<long long> sums;  // running per-cluster sums, kept up to date on reassignment (exact)
+    std::vector<size_t> counts;
+    std::vector<KMeansIterationStats> stats;
+
+    /** k-means++: the first centroid is a uniform pick, every next one is picked with probability
+     * proportional to its squared distance to the nearest centroid chosen so far */
+    void seed_centroids(const size_t k, const uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        const size_t n = this->data.size();
+        this->centroids.push_back(this->data[rng() % n]);
+
+        std::vector<double> nearest(n);
+        for (size_t i = 0; i < n; i++) {
+            const double d = this->data[i] - this->centroids[0];
+            nearest[i] = d * d;
+        }
+
+        while (this->centroids.size() < k) {
+            double total = 0.0;
+            for (const double d : nearest) {
+                total += d;
+            }
+
+            // every point already sits on a centroid, so any pick is as good as another
+            size_t pick = rng() % n;
+            if (total > 0.0) {
+                double target = std::uniform_real_distribution<double>(0.0, total)(rng);
+                pick = n - 1;
+                for (size_t i = 0; i < n; i++) {
+                    target -= nearest[i];
+                    if (target < 0.0) {
+                        pick = i;
+                        break;
+                    }
+                }
+            }
+
+            const double chosen = this->data[pick];
+            this->centroids.push_back(chosen);
+            for (size_t i = 0; i < n; i++) {
+                const double d = this->data[i] - chosen;
+                nearest[i] = std::min(nearest[i], d * d);
+            }
+        }
+    }
+
+    /** Runs the full distance loop for data[i]: assigns it to its nearest centroid and resets both of its bounds.
+     * Returns true if the point changed cluster. */
+    bool reassign(const size_t i) {
+        const double item = this->data[i];
+        size_t best = 0;
+        double best_distance = std::numeric_limits<double>::max();
+        double second_distance = std::numeric_limits<double>::max();
+        for (size_t c = 0; c < this->centroids.size(); c++) {
+            const double distance = std::abs(item - this->centroids[c]);
+            if (distance < best_distance) {
+                second_distance = best_distance;
+                best_distance = distance;
+                best = c;
+            } else if (distance < second_distance) {
+                second_distance = distance;
+            }
+        }
+
+        this->upper[i] = best_distance;
+        this->lower[i] = second_distance;
+
+        const size_t previous = this->labels[i];
+        if (previous == best) {
+            return false;
+        }
+
+        this->sums[previous] -= (long long) item;
+        this->counts[previous] -= 1;
+        this->sums[best] += (long long) item;
+        this->counts[best] += 1;
+        this->labels[i] = (uint32_t) best;
+        return true;
+    }
+
+    /** Moves every centroid to the mean of its cluster and loosens the bounds by the distance moved */
+    void move_centroids() {
+        const size_t k = this->centroids.size();
+        std::vector<double> drift(k, 0.0);
+        size_t furthest = 0;
+        for (size_t c = 0; c < k; c++) {
+            if (this->counts[c] > 0) {
+                // whole part in integers, so only the fraction is rounded even past 2^53
+                const long long count = (long long) this->counts[c];
+                const double moved_to = (double) (this->sums[c] / count) + (double) (this->sums[c] % count) / (double) count;
+                drift[c] = std::abs(moved_to - this->centroids[c]);
+                this->centroids[c] = moved_to;
+            }
+            furthest = drift[c] > drift[furthest] ? c : furthest;
+        }
+
+        double second_furthest = 0.0;
+        for (size_t c = 0; c < k; c++) {
+            second_furthest = c != furthest ? std::max(second_furthest, drift[c]) : second_furthest;
+        }
+
+        for (size_t i = 0; i < this->data.size(); i++) {
+            const size_t c = this->labels[i];
+            this->upper[i] += drift[c];
+            this->lower[i] -= c == furthest ? second_furthest : drift[furthest];
+        }
+    }
+
+    /** Half the distance from every centroid to its closest other centroid. A point within that of its
+     * own centroid cannot be closer to any other one. */
+    std::vector<double> half_gaps() const {
+        const size_t k = this->centroids.size();
+        std::vector<double> gaps(k, std::numeric_limits<double>::max());
+        for (size_t a = 0; a < k; a++) {
+            for (size_t b = 0; b < k; b++) {
+                if (a != b) {
+                    gaps[a] = std::min(gaps[a], std::abs(this->centroids[a] - this->centroids[b]) / 2.0);
+                }
+            }
+        }
+
+        return gaps;
+    }
+
+public:
+    /** Clusters `data` into `k` clusters, giving up after `max_iterations` if it has not converged by then */
+    DynamicKMeansClustering(std::vector<int>&& data, size_t k, uint64_t seed = 0, size_t max_iterations = 300)
+        : data(std::move(data)) {
+        if (k == 0) {
+            std::cout << "DynamicKMeansClustering needs at least one cluster" << std::endl;
+            abort();
+        }
+
+        const size_t n = this->data.size();
+        if (n == 0) {
+            this->centroids.assign(k, 0.0);
+            return;
+        }
+
+        using std::chrono::high_resolution_clock;
+        using std::chrono::duration;
+
+        // seeding and the first full assignment count as iteration 0
+        const auto t1 = high_resolution_clock::now();
+        this->seed_centroids(k, seed);
+        this->labels.assign(n, 0);
+        this->upper.resize(n);
+        this->lower.resize(n);
+        this->sums.assign(k, 0);
+        this->counts.assign(k, 0);
+        this->counts[0] = n;
+        for (const int item : this->data) {
+            this->sums[0] += (long long) item;
+        }
+
+        size_t reassigned = 0;
+        for (size_t i = 0; i < n; i++) {
+            reassigned += this->reassign(i);
+        }
+        this->move_centroids();
+        this->stats.push_back({ n, reassigned, duration<double, std::milli>(high_resolution_clock::now() - t1).count() });
+
+        while (reassigned > 0 && this->stats.size() <= max_iterations) {
+            const auto start = high_resolution_clock::now();
+            const std::vector<double> gaps = this->half_gaps();
+            size_t reexamined = 0;
+            reassigned = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                const double bound = std::max(gaps[this->labels[i]], this->lower[i]);
+                if (this->upper[i] <= bound) {
+                    continue;
+                }
+
+                // tighten the upper bound before paying for the full loop
+                this->upper[i] = std::abs(this->data[i] - this->centroids[this->labels[i]]);
+                if (this->upper[i] <= bound) {
+                    continue;
+                }
+
+                reexamined += 1;
+                reassigned += this->reassign(i);
+            }
+
+            this->move_centroids();
+            this->stats.push_back({ reexamined, reassigned, duration<double, std::milli>(high_resolution_clock::now() - start).count() });
+        }
+    }
+
+    /** Number of clusters */
+    size_t k() const {
+        return this->centroids.size();
+    }
+
+    /** Per-iteration instrumentation; entry 0 is the seeding plus the first full assignment */
+    const std::vector<KMeansIterationStats>& iteration_stats() const {
+        return this->stats;
+    }
+
+    /** Sum of squared distances from every point to its centroid, e.g. for picking k by the elbow */
+    double sum_of_squares() const {
+        double total = 0.0;
+        for (size_t i = 0; i < this->data.size(); i++) {
+            const double d = this->data[i] - this->centroids[this->labels[i]];
+            total += d * d;
+        }
+
+        return total;
+    }
+
+    /** Collects the clusters as a std::vector of std::vectors */
+    std::vector<std::vector<int>> collect_clusters() const {
+        std::vector<std::vector<int>> out(this->centroids.size());
+        for (size_t i = 0; i < this->data.size(); i++) {
+            out[this->labels[i]].push_back(this->data[i]);
+        }
+
+        return out;
+    }
+
+    /** Get the centroid of cluster index i */
+    int get_centroid(size_t i) const {
+        return (int) this->centroids[i];
+    }
+};
+
+/** Reads a binary file of int32 values front to back, `chunk_items` values at a time. Where mmap is
+ * available only the window of the current chunk is mapped, elsewhere chunks are fread into a buffer;
+ * either way memory use is one chunk whatever the size of the file. A trailing partial value is ignored. */
+class Int32ChunkReader {
+private:
+    size_t chunk_items;
+#if KMEANS_POSIX_MMAP
+    int fd;
+    size_t file_bytes;
+    size_t offset;        // byte offset of the next chunk
+    void* window;
+    size_t window_bytes;
+
+    void unmap() {
+        if (this->window != nullptr) {
+            munmap(this->window, this->window_bytes);
+            this->window = nullptr;
+        }
+    }
+#else
+    std::FILE* file;
+    std::vector<int32_t> buffer;
+#endif
+
+public:
+    Int32ChunkReader(const std::string& path, size_t chunk_items): chunk_items(std::max<size_t>(1, chunk_items)) {
+#if KMEANS_POSIX_MMAP
+        this->fd = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (this->fd < 0 || fstat(this->fd, &info) != 0) {
+            std::cout << "could not open input file " << path << std::endl;
+            abort();
+        }
+
+        this->file_bytes = (size_t) info.st_size - (size_t) info.st_size % sizeof(int32_t);
+        this->offset = 0;
+        this->window = nullptr;
+        this->window_bytes = 0;
+#else
+        this->file = std::fopen(path.c_str(), "rb");
+        if (this->file == nullptr) {
+            std::cout << "could not open input file " << path << std::endl;
+            abort();
+        }
+
+        this->buffer.resize(this->chunk_items);
+#endif
+    }
+
+    Int32ChunkReader(const Int32ChunkReader&) = delete;
+    Int32ChunkReader& operator=(const Int32ChunkReader&) = delete;
+
+    ~Int32ChunkReader() {
+#if KMEANS_POSIX_MMAP
+        this->unmap();
+        close(this->fd);
+#else
+        std::fclose(this->file);
+#endif
+    }
+
+    /** The next chunk of values, empty once the file is exhausted. Invalidated by the next call. */
+    std::span<const int32_t> next() {
+#if KMEANS_POSIX_MMAP
+        this->unmap();
+        if (this->offset >= this->file_bytes) {
+            return {};
+        }
+
+        // mappings have to start on a page boundary, so the window may begin a little before the chunk
+        static const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        const size_t start = this->offset - this->offset % page;
+        const size_t bytes = std::min(this->chunk_items * sizeof(int32_t), this->file_bytes - this->offset);
+        this->window_bytes = this->offset - start + bytes;
+        this->window = mmap(nullptr, this->window_bytes, PROT_READ, MAP_PRIVATE, this->fd, (off_t) start);
+        if (this->window == MAP_FAILED) {
+            this->window = nullptr;
+            std::cout << "could not map the input file" << std::endl;
+            abort();
+        }
+        madvise(this->window, this->window_bytes, MADV_SEQUENTIAL);
+
+        const int32_t* first = reinterpret_cast<const int32_t*>(static_cast<const char*>(this->window) + (this->offset - start));
+        this->offset += bytes;
+        return std::span<const int32_t>(first, bytes / sizeof(int32_t));
+#else
+        const size_t count = std::fread(this->buffer.data(), sizeof(int32_t), this->buffer.size(), this->file);
+        return std::span<const int32_t>(this->buffer.data(), count);
+#endif
+    }
+};
+
+/** Mini-batch k-means (Sculley's web-scale k-means) over int32 files that do not fit in memory. The file
+ * is streamed in batches of `batch_size` values; every batch is first labelled against the centroids as
+ * they stood at its start, then each value pulls its centroid towards itself with a per-cluster learning
+ * rate of 1 / (values that cluster has seen so far). Seeded with the first `clusters` values of the file,
+ * like the in-memory engines. Peak memory is O(clusters + batch_size). */
+template <size_t clusters>
+class StreamingKMeans {
+private:
+    std::array<double, clusters> centroids;
+    std::array<size_t, clusters> seen;    // values each cluster has absorbed, drives its learning rate
+    size_t seeded;                        // how many centroids have been seeded so far
+    size_t batch_size;
+    std::vector<cluster_label_t<clusters>> batch_labels;
+
+    /** Given some int `item` returns the nearest of the seeded clusters */
+    size_t nearest_centroid(const double item) const {
+        size_t best = 0;
+        double best_distance = std::numeric_limits<double>::max();
+        for (size_t c = 0; c < this->seeded; c++) {
+            const double distance = std::abs(this->centroids[c] - item);
+            best = distance < best_distance ? c : best;
+            best_distance = std::min(distance, best_distance);
+        }
+
+        return best;
+    }
+
+    /** Labels `batch` against the current centroids, then applies the per-cluster gradient steps */
+    void learn_batch(std::span<const int32_t> batch) {
+        // the first values of the stream become the seeds
+        size_t start = 0;
+        while (this->seeded < clusters && start < batch.size()) {
+            this->centroids[this->seeded] = batch[start];
+            this->seen[this->seeded] = 1;
+            this->seeded += 1;
+            start += 1;
+        }
+
+        batch = batch.subspan(start);
+        for (size_t i = 0; i < batch.size(); i++) {
+            this->batch_labels[i] = (cluster_label_t<clusters>) this->nearest_centroid(batch[i]);
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            const size_t c = this->batch_labels[i];
+            this->seen[c] += 1;
+            const double rate = 1.0 / (double) this->seen[c];
+            this->centroids[c] += rate * (batch[i] - this->centroids[c]);
+        }
+    }
+
+public:
+    StreamingKMeans(size_t batch_size = 1 << 16): centroids({}), seen({}), seeded(0), batch_size(std::max<size_t>(1, batch_size)) {
+        this->batch_labels.resize(this->batch_size);
+    }
+
+    /** Streams `path` through the model `passes` times */
+    void fit(const std::string& path, size_t passes = 1) {
+        for (size_t pass = 0; pass < passes; pass++) {
+            Int32ChunkReader reader(path, this->batch_size);
+            for (std::span<const int32_t> batch = reader.next(); !batch.empty(); batch = reader.next()) {
+                this->learn_batch(batch);
+            }
+        }
+    }
+
+    /** Final pass: labels every value of `in_path` with its nearest centroid and writes the labels,
+     * one cluster_label_t<clusters> per value in input order, to `out_path`. Returns the number of values. */
+    size_t assign(const std::string& in_path, const std::string& out_path) {
+        std::FILE* out = std::fopen(out_path.c_str(), "wb");
+        if (out == nullptr) {
+            std::cout << "could not open output file " << out_path << std::endl;
+            abort();
+        }
+
+        size_t total = 0;
+        Int32ChunkReader reader(in_path, this->batch_size);
+        for (std::span<const int32_t> batch = reader.next(); !batch.empty(); batch = reader.next()) {
+            for (size_t i = 0; i < batch.size(); i++) {
+                this->batch_labels[i] = (cluster_label_t<clusters>) this->nearest_centroid(batch[i]);
+            }
+
+            if (std::fwrite(this->batch_labels.data(), sizeof(cluster_label_t<clusters>), batch.size(), out) != batch.size()) {
+                std::cout << "could not write output file " << out_path << std::endl;
+                abort();
+            }
+            total += batch.size();
+        }
+
+        if (std::fclose(out) != 0) {
+            std::cout << "could not close output file " << out_path << std::endl;
+            abort();
+        }
+        return total;
+    }
+
+    /** Values cluster index i has absorbed while fitting */
+    size_t cluster_weight(size_t i) const {
+        return this->seen[i];
+    }
+
+    /** Get the centroid of cluster index i */
+    int get_centroid(size_t i) const {
+        return (int) this->centroids[i];
+    }
+};
+
+/** Evaluates to true if the CPU we are running on has AVX2. Checked once. */
+inline bool cpu_has_avx2() {
+#if KMEANS_X86_SIMD
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+#else
+    return false;
+#endif
+}
+
+/** Quantizes ints to the nearest centroid of a fitted model at batch rates. The centroids are sorted
+ * and the cut between neighbours is kept as an integer boundary floor((c_i + c_{i+1}) / 2): a value
+ * belongs to sorted centroid r when exactly r boundaries lie below it, so encoding is a
+ * compare-and-count against clusters - 1 boundaries, no k-loop and no branches. A value sitting exactly
+ * on a boundary goes to the lower centroid. Codes index the sorted centroids; `cluster_of` maps them
+ * back to the model's cluster indices. */
+template <size_t clusters>
+class KMeansQuantizer {
+private:
+    static_assert(clusters >= 1 && clusters <= 256, "KMeansQuantizer codes are single bytes");
+
+    std::array<int, clusters> sorted_centroids;
+    std::array<uint8_t, clusters> clusters_by_code;
+    std::array<int, clusters - 1> boundaries;
+
+    KMeansQuantizer(): sorted_centroids({}), clusters_by_code({}), boundaries({}) {}
+
+    /** Code of a single value */
+    uint8_t encode_one(const int item) const {
+        uint32_t code = 0;
+        for (const int boundary : this->boundaries) {
+            code += item > boundary;
+        }
+
+        return (uint8_t) code;
+    }
+
+    void encode_scalar(const int* in, uint8_t* out, size_t n) const {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = this->encode_one(in[i]);
+        }
+    }
+
+#if KMEANS_X86_SIMD
+    /** encode_scalar, 32 values per round: every boundary costs one compare per 8 values (a true lane is
+     * -1, so subtracting the mask counts), then the four vectors of counts are packed down to bytes */
+    __attribute__((target("avx2")))
+    void encode_avx2(const int* in, uint8_t* out, size_t n) const {
+        __m256i cuts[clusters > 1 ? clusters - 1 : 1];
+        for (size_t b = 0; b < clusters - 1; b++) {
+            cuts[b] = _mm256_set1_epi32(this->boundaries[b]);
+        }
+        // packs interleave the 128 bit lanes, this puts the 4 byte groups back in input order
+        const __m256i unshuffle = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i counts[4];
+            for (size_t v = 0; v < 4; v++) {
+                const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8 * v));
+                __m256i count = _mm256_setzero_si256();
+                for (size_t b = 0; b < clusters - 1; b++) {
+                    count = _mm256_sub_epi32(count, _mm256_cmpgt_epi32(block, cuts[b]));
+                }
+                counts[v] = count;
+            }
+
+            const __m256i low = _mm256_packs_epi32(counts[0], counts[1]);
+            const __m256i high = _mm256_packs_epi32(counts[2], counts[3]);
+            const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), unshuffle);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), bytes);
+        }
+
+        this->encode_scalar(in + i, out + i, n - i);
+    }
+#endif
+
+public:
+    /** Builds the quantizer from any fitted model exposing get_centroid for `clusters` clusters */
+    template <typename Model>
+    static KMeansQuantizer from(Model& model) {
+        KMeansQuantizer q;
+        std::array<size_t, clusters> order;
+        for (size_t c = 0; c < clusters; c++) {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&model](size_t a, size_t b) {
+            return model.get_centroid(a) < model.get_centroid(b);
+        });
+
+        for (size_t r = 0; r < clusters; r++) {
+            q.sorted_centroids[r] = model.get_centroid(order[r]);
+            q.clusters_by_code[r] = (uint8_t) order[r];
+        }
+
+        for (size_t r = 0; r + 1 < clusters; r++) {
+            const long long sum = (long long) q.sorted_centroids[r] + (long long) q.sorted_centroids[r + 1];
+            q.boundaries[r] = (int) (sum >= 0 ? sum / 2 : -((-sum + 1) / 2));
+        }
+
+        return q;
+    }
+
+    /** Writes the code of every value of `in` to the same position of `out`, which must be at least as long */
+    void encode(std::span<const int> in, std::span<uint8_t> out) const {
+        if (out.size() < in.size()) {
+            std::cout << "KMeansQuantizer::encode was given an output shorter than its input" << std::endl;
+            abort();
+        }
+
+#if KMEANS_X86_SIMD
+        if (cpu_has_avx2()) {
+            this->encode_avx2(in.data(), out.data(), in.size());
+            return;
+        }
+#endif
+        this->encode_scalar(in.data(), out.data(), in.size());
+    }
+
+    /** The centroid a code stands for */
+    int centroid(uint8_t code) const {
+        return this->sorted_centroids[code];
+    }
+
+    /** The model's cluster index a code stands for */
+    size_t cluster_of(uint8_t code) const {
+        return this->clusters_by_code[code];
+    }
+};
+
+/** Sum of squared distances from every member to its cluster's centroid, for comparing engines */
+template <size_t clusters, typename Model>
+double within_cluster_ss(Model& model) {
+    std::array<std::vector<int>, clusters> members = model.collect_clusters();
+    double total = 0.0;
+    for (size_t c = 0; c < clusters; c++) {
+        const double centroid = model.get_centroid(c);
+        for (const int item : members[c]) {
+            total += (item - centroid) * (item - centroid);
+        }
+    }
+
+    return total;
+}
+
+/** Times `f` and prints it in the same format as the other snippets */
+template <typename F>
+long long time_ms(const std::string& label, F&& f) {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+
+    const auto t1 = high_resolution_clock::now();
+    f();
+    const auto t2 = high_resolution_clock::now();
+
+    const auto ms_int = duration_cast<milliseconds>(t2 - t1);
+    std::cout << label << " took " << ms_int.count() << "ms" << std::endl;
+    return ms_int.count();
+}
+
+/** Fits `Engine` on a copy of `data` and reports the time and the resulting within-cluster SS */
+template <size_t clusters, typename Engine>
+void bench_engine(const std::string& name, const std::vector<int>& data) {
+    std::vector<int> copy = data;
+    std::optional<KMeansClustering<clusters, Engine>> model;
+    time_ms(name, [&]() {
+        model.emplace(std::move(copy));
+    });
+
+    std::cout << "  within-cluster SS = " << within_cluster_ss<clusters>(*model) << std::endl;
+}
+
+/** Times ParallelLloydKE on 1, 2, 4, .. max_threads threads and checks every run against the 1 thread centroids */
+template <size_t clusters>
+void bench_parallel_scaling(const std::vector<int>& data, size_t max_threads) {
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::array<int, clusters> reference = {};
+    for (const size_t threads : thread_counts) {
+        std::vector<int> copy = data;
+        std::optional<KMeansClustering<clusters, ParallelLloydKE>> model;
+        const long long ms = time_ms("KMeansClustering<ParallelLloydKE> on " + std::to_string(threads) + " thread(s)", [&]() {
+            model.emplace(std::move(copy), threads);
+        });
+
+        bool same = true;
+        for (size_t c = 0; c < clusters; c++) {
+            same = same && (threads == 1 || model->get_centroid(c) == reference[c]);
+            reference[c] = threads == 1 ? model->get_centroid(c) : reference[c];
+        }
+        std::cout << "  " << model->iteration_count() << " iterations, "
+            << (ms > 0 ? (double) data.size() * model->iteration_count() / ms / 1000.0 : 0.0) << "M points/s"
+            << (same ? "" : ", CENTROIDS DIFFER FROM 1 THREAD") << std::endl;
+    }
+}
+
+/** Fits DynamicKMeansClustering with `k` clusters on a copy of `data` and prints its per-iteration stats */
+void bench_dynamic(const std::vector<int>& data, size_t k) {
+    std::vector<int> copy = data;
+    std::optional<DynamicKMeansClustering> model;
+    time_ms("DynamicKMeansClustering(k = " + std::to_string(k) + ")", [&]() {
+        model.emplace(std::move(copy), k);
+    });
+
+    const std::vector<KMeansIterationStats>& stats = model->iteration_stats();
+    size_t reexamined = 0;
+    for (size_t it = 0; it < stats.size(); it++) {
+        reexamined += stats[it].reexamined;
+        // the first few iterations, then every tenth, are enough to see the bounds kick in
+        if (it < 5 || it % 10 == 0 || it + 1 == stats.size()) {
+            std::cout << "  iteration " << it << ": re-examined " << stats[it].reexamined
+                << ", reassigned " << stats[it].reassigned << ", " << stats[it].ms << "ms" << std::endl;
+        }
+    }
+
+    std::cout << "  " << stats.size() << " iterations, " << 100.0 * reexamined / ((double) data.size() * stats.size())
+        << "% of point-iterations ran the distance loop, SS = " << model->sum_of_squares() << std::endl;
+}
+
+/** Streams `data` through StreamingKMeans from a scratch file, writes the labels back out and reports
+ * throughput plus the within-cluster SS of those labels */
+template <size_t clusters>
+void bench_streaming(const std::vector<int>& data) {
+    const std::string in_path = (std::filesystem::temp_directory_path() / "kmeans_stream_input.bin").string();
+    const std::string out_path = (std::filesystem::temp_directory_path() / "kmeans_stream_labels.bin").string();
+    std::FILE* in = std::fopen(in_path.c_str(), "wb");
+    if (in == nullptr) {
+        std::cout << "could not open scratch file " << in_path << std::endl;
+        abort();
+    }
+    const bool written = std::fwrite(data.data(), sizeof(int), data.size(), in) == data.size();
+    if (std::fclose(in) != 0 || !written) {
+        std::cout << "could not write scratch file " << in_path << std::endl;
+        abort();
+    }
+
+    const double mb = (double) (data.size() * sizeof(int)) / (1024.0 * 1024.0);
+    StreamingKMeans<clusters> model;
+    const long long fit_ms = time_ms("StreamingKMeans::fit", [&]() {
+        model.fit(in_path);
+    });
+    const long long assign_ms = time_ms("StreamingKMeans::assign", [&]() {
+        model.assign(in_path, out_path);
+    });
+
+    // the labels are read back in batches as well, the benchmark itself already holds the data
+    std::FILE* labels = std::fopen(out_path.c_str(), "rb");
+    if (labels == nullptr) {
+        std::cout << "could not open label file " << out_path << std::endl;
+        abort();
+    }
+    std::vector<cluster_label_t<clusters>> batch(1 << 16);
+    double total = 0.0;
+    size_t i = 0;
+    for (size_t got = std::fread(batch.data(), sizeof(batch[0]), batch.size(), labels); got > 0;
+        got = std::fread(batch.data(), sizeof(batch[0]), batch.size(), labels)) {
+        for (size_t b = 0; b < got; b++, i++) {
+            const double d = data[i] - (double) model.get_centroid(batch[b]);
+            total += d * d;
+        }
+    }
+    std::fclose(labels);
+    std::remove(in_path.c_str());
+    std::remove(out_path.c_str());
+
+    std::cout << "  fit " << (fit_ms > 0 ? mb * 1000.0 / fit_ms : 0.0) << " MB/s, assign "
+        << (assign_ms > 0 ? mb * 1000.0 / assign_ms : 0.0) << " MB/s, within-cluster SS = " << total << std::endl;
+}
+
+/** Quantizes `data` through a KMeansQuantizer built from an OptimalKE fit and reports input GB/s,
+ * next to a plain per-value k-loop doing the same job */
+template <size_t clusters>
+void bench_quantizer(const std::vector<int>& data) {
+    KMeansClustering<clusters, OptimalKE> model{std::vector<int>(data)};
+    const KMeansQuantizer<clusters> quantizer = KMeansQuantizer<clusters>::from(model);
+    std::vector<uint8_t> codes(data.size());
+    std::vector<uint8_t> naive(data.size());
+    constexpr int ROUNDS = 10;
+    const double gb = (double) (data.size() * sizeof(int)) * ROUNDS / 1e9;
+
+    const long long encode_ms = time_ms("KMeansQuantizer::encode x" + std::to_string(ROUNDS), [&]() {
+        for (int r = 0; r < ROUNDS; r++) {
+            quantizer.encode(data, codes);
+        }
+    });
+    const long long naive_ms = time_ms("per-value k-loop x" + std::to_string(ROUNDS), [&]() {
+        for (int r = 0; r < ROUNDS; r++) {
+            for (size_t i = 0; i < data.size(); i++) {
+                uint8_t best = 0;
+                for (size_t code = 1; code < clusters; code++) {
+                    const bool closer = std::abs(data[i] - quantizer.centroid(code)) < std::abs(data[i] - quantizer.centroid(best));
+                    best = closer ? (uint8_t) code : best;
+                }
+                naive[i] = best;
+            }
+        }
+    });
+
+    std::cout << "  encode " << (encode_ms > 0 ? gb * 1000.0 / encode_ms : 0.0) << " GB/s (avx2: " << (cpu_has_avx2() ? "yes" : "no")
+        << "), k-loop " << (naive_ms > 0 ? gb * 1000.0 / naive_ms : 0.0) << " GB/s, codes "
+        << (codes == naive ? "match" : "DIFFER") << std::endl;
+}
+
+/** Runs every engine on n = 10^6 .. 10^max_exponent random points */
+void run_benchmarks(int max_exponent, int ub, size_t max_threads) {
+    constexpr size_t CLUSTERS = 8;
+    size_t n = 1'000'000;
+    for (int e = 6; e <= max_exponent; e++) {
+        std::cout << "\n[n = " << n << ", values in [0, " << ub << "), k = " << CLUSTERS << "]" << std::endl;
+        std::cout << "==============================" << std::endl;
+        const std::vector<int> data = random_data(n, ub);
+
+        // the linked list engine needs minutes at 10^7 points already
+        if (e <= 7) {
+            bench_engine<CLUSTERS, LloydKE>("KMeansClustering<LloydKE>", data);
+        }
+        bench_engine<CLUSTERS, HistogramKE>("KMeansClustering<HistogramKE>", data);
+        bench_engine<CLUSTERS, SortedRangeKE>("KMeansClustering<SortedRangeKE>", data);
+        bench_engine<CLUSTERS, OptimalKE>("KMeansClustering<OptimalKE>", data);
+        bench_parallel_scaling<CLUSTERS>(data, max_threads);
+        bench_dynamic(data, CLUSTERS);
+        bench_streaming<CLUSTERS>(data);
+        bench_quantizer<CLUSTERS>(data);
+        n *= 10;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        const size_t max_threads = argc > 4 ? std::atoi(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+        run_benchmarks(argc > 2 ? std::atoi(argv[2]) : 8, argc > 3 ? std::atoi(argv[3]) : 100'000, max_threads);
+        return 0;
+    }
+
     std::vector<int> data = random_data(30);
 
     std::cout << "INITIAL DATA: ";
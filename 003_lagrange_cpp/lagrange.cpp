@@ -2,27 +2,138 @@
 #include <iostream>
 #include <array>
 #include <limits>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+#include <tuple>
+#include <span>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LAGRANGE_X86_SIMD 1
+#else
+#define LAGRANGE_X86_SIMD 0
+#endif
+
+/** Floats a Point<D> is stored in: D rounded up to 1, 2 or 4 floats (part or all of an SSE register),
+ * and past that to a multiple of 8 (whole AVX registers). Arithmetic runs over every stored float so
+ * the compiler can vectorize it without a remainder loop. The extra floats start at zero and are never read. */
+constexpr size_t point_lanes(size_t D) {
+	if (D <= 2) {
+		return D == 0 ? 1 : D;
+	}
+
+	return D <= 4 ? 4 : (D + 7) / 8 * 8;
+}
+
+template <size_t D>
+struct Point;
+
+/** Base of Point<D> and of the lazy arithmetic on Points (CRTP, like VecExpression in
+ * 016_expression_template_cpp). `p + s * q` builds a small expression object instead of temporary
+ * Points, and assigning it to a Point evaluates it in one pass over the lanes. */
+template <size_t D, typename Derived>
+struct PointExpression {
+	float lane(size_t i) const {
+		return static_cast<const Derived&>(*this).lane(i);
+	}
+};
+
+/** Points are held by reference inside an expression, sub-expressions (temporaries) by value */
+template <typename E>
+struct PointOperand {
+	typedef const E type;
+};
+
+template <size_t D>
+struct PointOperand<Point<D>> {
+	typedef const Point<D>& type;
+};
+
+/** Representation of p + q */
+template <size_t D, typename E1, typename E2>
+struct PointSum : public PointExpression<D, PointSum<D, E1, E2>> {
+	typename PointOperand<E1>::type p;
+	typename PointOperand<E2>::type q;
+
+	PointSum(const E1& p, const E2& q) : p(p), q(q) {}
+
+	float lane(size_t i) const {
+		return this->p.lane(i) + this->q.lane(i);
+	}
+};
+
+/** Representation of p - q */
+template <size_t D, typename E1, typename E2>
+struct PointDifference : public PointExpression<D, PointDifference<D, E1, E2>> {
+	typename PointOperand<E1>::type p;
+	typename PointOperand<E2>::type q;
+
+	PointDifference(const E1& p, const E2& q) : p(p), q(q) {}
+
+	float lane(size_t i) const {
+		return this->p.lane(i) - this->q.lane(i);
+	}
+};
+
+/** Representation of scalar * p */
+template <size_t D, typename E>
+struct PointScale : public PointExpression<D, PointScale<D, E>> {
+	const float scalar;
+	typename PointOperand<E>::type p;
+
+	PointScale(float scalar, const E& p) : scalar(scalar), p(p) {}
+
+	float lane(size_t i) const {
+		return this->scalar * this->p.lane(i);
+	}
+};
 
 /** A point. You get the point. */
 template <size_t D>
-struct Point {
+struct Point : public PointExpression<D, Point<D>> {
+	static constexpr size_t LANES = point_lanes(D);
 private:
-	std::array<float,D> buffer;	
+	alignas(std::min<size_t>(LANES * sizeof(float), 32)) std::array<float,LANES> buffer{};
+
+	template <typename E>
+	void assign(const PointExpression<D, E>& e) {
+		for (size_t i = 0; i < LANES; i++) {
+			this->buffer[i] = e.lane(i);
+		}
+	}
 public:
-	Point() : buffer() {}
+	Point() {}
+
+	Point(const std::array<float,D>& data) {
+		std::copy(data.begin(), data.end(), this->buffer.begin());
+	}
+
+	/** Evaluates a lazy expression, see PointExpression */
+	template <typename E>
+	Point(const PointExpression<D, E>& e) {
+		this->assign(e);
+	}
+
+	template <typename E>
+	Point& operator=(const PointExpression<D, E>& e) {
+		this->assign(e);
+		return *this;
+	}
 
 	template <size_t S>
 	static Point<S> from(std::array<float,S>&& data) {
-		return Point<S>{
-			data
-		};
+		return Point<S>(data);
 	}
 
 	template <size_t S>
 	static Point<S> from(std::array<float,S> data) {
-		return Point<S> {
-			std::move(data)
-		};
+		return Point<S>(data);
 	}
 
 		
@@ -37,27 +148,19 @@ public:
 	/** Initialize a Point of zeroes */
 	template <size_t S>
 	static Point<S> zeroes() {
-		return Point<S> {
-			{}
-		};
+		return Point<S>();
 	}
 
 	template <size_t S>
 	static Point<S> ones() {
-		std::array<float,S> A;
-		A.fill(1);
-		return Point<S> {
-			std::move(A)		
-		};
+		return Point::Ns<S>(1.f);
 	}
 
 	template <size_t S>
 	static Point<S> Ns(float f) {
 		std::array<float,S> A;
 		A.fill(f);
-		return Point<S> {
-			std::move(A)
-		};
+		return Point<S>(A);
 	}
 
 	float& operator[](int index) {
@@ -68,37 +171,37 @@ public:
 		return this->buffer[index];
 	}
 
-	friend Point<D> operator*(const float scalar, const Point<D>& p) {
-		Point<D> output = {};
-		for (int i = 0; i < D; i++) {
-			output[i] = scalar * p[i];
-		}
-		return output;
+	float lane(size_t i) const {
+		return this->buffer[i];
 	}
 
-	friend Point<D> operator*(const Point<D>& p, const float scalar) {
-		return scalar * p;
+	template <typename E>
+	Point& operator+=(const PointExpression<D, E>& e) {
+		for (size_t i = 0; i < LANES; i++) {
+			this->buffer[i] += e.lane(i);
+		}
+		return *this;
 	}
 
-	friend Point<D> operator+(const Point<D>& p, const Point<D>& q) {
-		Point<D> output = {};
-		for (int i = 0; i < D; i++) {
-			output[i] = p[i] + q[i];
+	template <typename E>
+	Point& operator-=(const PointExpression<D, E>& e) {
+		for (size_t i = 0; i < LANES; i++) {
+			this->buffer[i] -= e.lane(i);
 		}
-		return output;
+		return *this;
 	}
 
-	friend Point<D> operator-(const Point<D>& p, const Point<D>& q) {
-		Point<D> output = {};
-		for (int i = 0; i < D; i++) {
-			output[i] = p[i] - q[i];
+	/** this += a * x in one pass, a multiply-add per lane */
+	Point& axpy(const float a, const Point<D>& x) {
+		for (size_t i = 0; i < LANES; i++) {
+			this->buffer[i] += a * x.buffer[i];
 		}
-		return output;
+		return *this;
 	}
 
 	friend std::ostream& operator<<(std::ostream& os, const Point<D>& p) {
 		os << "[";
-		for (int i = 0; i < D; i++) {
+		for (size_t i = 0; i < D; i++) {
 			os << p[i] << ", ";
 		}
 		os << "]";
@@ -106,13 +209,250 @@ public:
 	}
 };
 
+/** LAZY EXPRESSIONS */
+
+template <size_t D, typename E1, typename E2>
+PointSum<D, E1, E2> operator+(const PointExpression<D, E1>& p, const PointExpression<D, E2>& q) {
+	return PointSum<D, E1, E2>(static_cast<const E1&>(p), static_cast<const E2&>(q));
+}
+
+template <size_t D, typename E1, typename E2>
+PointDifference<D, E1, E2> operator-(const PointExpression<D, E1>& p, const PointExpression<D, E2>& q) {
+	return PointDifference<D, E1, E2>(static_cast<const E1&>(p), static_cast<const E2&>(q));
+}
+
+template <size_t D, typename E>
+PointScale<D, E> operator*(const float scalar, const PointExpression<D, E>& p) {
+	return PointScale<D, E>(scalar, static_cast<const E&>(p));
+}
+
+template <size_t D, typename E>
+PointScale<D, E> operator*(const PointExpression<D, E>& p, const float scalar) {
+	return PointScale<D, E>(scalar, static_cast<const E&>(p));
+}
+
+/** How batch evaluation reads and writes the float components of a control point. Control point
+ * types without a specialization are still accepted, they are just evaluated one query at a time. */
+template <typename T>
+struct ControlPointLanes {
+	static constexpr size_t components = 0;
+};
+
+template <>
+struct ControlPointLanes<float> {
+	static constexpr size_t components = 1;
+
+	static float get(const float& p, size_t) {
+		return p;
+	}
+
+	static void set(float& p, size_t, float value) {
+		p = value;
+	}
+};
+
+template <size_t D>
+struct ControlPointLanes<Point<D>> {
+	static constexpr size_t components = D;
+
+	static float get(const Point<D>& p, size_t c) {
+		return p[(int) c];
+	}
+
+	static void set(Point<D>& p, size_t c, float value) {
+		p[(int) c] = value;
+	}
+};
+
+/** GCC vector types holding LANES queries at once. 4 lanes is plain SSE/NEON, 8 is AVX2, 16 is AVX-512. */
+template <size_t LANES>
+struct QueryLanes;
+
+template <>
+struct QueryLanes<4> {
+	typedef float floats __attribute__((vector_size(16)));
+	typedef int32_t ints __attribute__((vector_size(16)));
+};
+
+template <>
+struct QueryLanes<8> {
+	typedef float floats __attribute__((vector_size(32)));
+	typedef int32_t ints __attribute__((vector_size(32)));
+};
+
+template <>
+struct QueryLanes<16> {
+	typedef float floats __attribute__((vector_size(64)));
+	typedef int32_t ints __attribute__((vector_size(64)));
+};
+
+/** Evaluates to true if the CPU we are running on has AVX2. Checked once. */
+inline bool cpu_has_avx2() {
+#if LAGRANGE_X86_SIMD
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+#else
+	return false;
+#endif
+}
+
+/** Evaluates to true if the CPU we are running on has AVX-512F. Checked once. */
+inline bool cpu_has_avx512f() {
+#if LAGRANGE_X86_SIMD
+	static const bool has_avx512f = __builtin_cpu_supports("avx512f");
+	return has_avx512f;
+#else
+	return false;
+#endif
+}
+
+/** n Chebyshev points of the second kind, cos(pi * i / (n - 1)), mapped onto [a, b] in ascending order.
+ * Interpolating on these instead of evenly spaced points keeps Lagrange well conditioned at any n. */
+std::vector<float> chebyshev_nodes(int n, float a, float b) {
+	std::vector<float> nodes(n);
+	const double pi = std::acos(-1.0);
+	for (int i = 0; i < n; i++) {
+		const double t = n > 1 ? -std::cos(pi * i / (n - 1)) : 0.0;
+		nodes[i] = (float) (0.5 * (a + b) + 0.5 * (b - a) * t);
+	}
+
+	return nodes;
+}
+
+/** A polynomial on [a, b] as a sum of Chebyshev polynomials c_0 T_0(t) + ... + c_{n-1} T_{n-1}(t),
+ * t being x mapped onto [-1, 1]. Evaluated with Clenshaw's recurrence: O(n), no divisions. */
+template<typename NumericType>
+class ChebyshevSeries {
+private:
+    float m_scale; // t = x * m_scale + m_shift
+    float m_shift;
+    std::vector<NumericType> m_coefficients;
+
+public:
+    ChebyshevSeries(float a, float b, std::vector<NumericType>&& coefficients)
+        : m_scale(b > a ? 2.f / (b - a) : 0.f), m_shift(b > a ? -(a + b) / (b - a) : 0.f), m_coefficients(std::move(coefficients)) {}
+
+    // The coefficients, lowest degree first
+    const std::vector<NumericType>& coefficients() const {
+        return this->m_coefficients;
+    }
+
+    // Clenshaw: b_k = c_k + 2t b_{k+1} - b_{k+2}, p = c_0 + t b_1 - b_2
+    NumericType compute(float x) const {
+        const float t = x * this->m_scale + this->m_shift;
+        const float two_t = 2.f * t;
+        const int n = (int) this->m_coefficients.size();
+        NumericType b1 = 0.f * this->m_coefficients[0];
+        NumericType b2 = b1;
+
+        for (int k = n - 1; k >= 1; k--) {
+            // c_k - b_{k+2} does not wait on the previous step, only the multiply-add does
+            const NumericType b0 = (this->m_coefficients[k] - b2) + two_t * b1;
+            b2 = b1;
+            b1 = b0;
+        }
+
+        return (this->m_coefficients[0] - b2) + t * b1;
+    }
+
+    // compute for every xs[j] into out[j]. Clenshaw is one long dependency chain per query, so
+    // BLOCK queries are stepped through the recurrence together to keep the FPU busy.
+    void compute_batch(std::span<const float> xs, std::span<NumericType> out) const {
+        constexpr size_t BLOCK = 8;
+        const int n = (int) this->m_coefficients.size();
+        size_t j = 0;
+        for (; j + BLOCK <= xs.size(); j += BLOCK) {
+            float two_t[BLOCK];
+            NumericType b1[BLOCK];
+            NumericType b2[BLOCK];
+            for (size_t l = 0; l < BLOCK; l++) {
+                two_t[l] = 2.f * (xs[j + l] * this->m_scale + this->m_shift);
+                b1[l] = 0.f * this->m_coefficients[0];
+                b2[l] = b1[l];
+            }
+
+            for (int k = n - 1; k >= 1; k--) {
+                for (size_t l = 0; l < BLOCK; l++) {
+                    const NumericType b0 = (this->m_coefficients[k] - b2[l]) + two_t[l] * b1[l];
+                    b2[l] = b1[l];
+                    b1[l] = b0;
+                }
+            }
+
+            for (size_t l = 0; l < BLOCK; l++) {
+                out[j + l] = (this->m_coefficients[0] - b2[l]) + (0.5f * two_t[l]) * b1[l];
+            }
+        }
+
+        for (; j < xs.size(); j++) {
+            out[j] = this->compute(xs[j]);
+        }
+    }
+};
+
+/** A polynomial in plain powers of x, c_0 + c_1 x + ... + c_{n-1} x^{n-1}, evaluated with Horner's
+ * rule. Cheapest to evaluate, but the coefficients lose accuracy fast as n grows or [a, b] moves
+ * away from 0; prefer ChebyshevSeries past a dozen or so nodes. */
+template<typename NumericType>
+class MonomialSeries {
+private:
+    std::vector<NumericType> m_coefficients;
+
+public:
+    MonomialSeries(std::vector<NumericType>&& coefficients) : m_coefficients(std::move(coefficients)) {}
+
+    // The coefficients, lowest degree first
+    const std::vector<NumericType>& coefficients() const {
+        return this->m_coefficients;
+    }
+
+    NumericType compute(float x) const {
+        const int n = (int) this->m_coefficients.size();
+        NumericType output = this->m_coefficients[n - 1];
+        for (int k = n - 2; k >= 0; k--) {
+            output = this->m_coefficients[k] + x * output;
+        }
+
+        return output;
+    }
+
+    // compute for every xs[j] into out[j], BLOCK Horner chains at a time
+    void compute_batch(std::span<const float> xs, std::span<NumericType> out) const {
+        constexpr size_t BLOCK = 8;
+        const int n = (int) this->m_coefficients.size();
+        size_t j = 0;
+        for (; j + BLOCK <= xs.size(); j += BLOCK) {
+            NumericType acc[BLOCK];
+            for (size_t l = 0; l < BLOCK; l++) {
+                acc[l] = this->m_coefficients[n - 1];
+            }
+
+            for (int k = n - 2; k >= 0; k--) {
+                for (size_t l = 0; l < BLOCK; l++) {
+                    acc[l] = this->m_coefficients[k] + xs[j + l] * acc[l];
+                }
+            }
+
+            for (size_t l = 0; l < BLOCK; l++) {
+                out[j + l] = acc[l];
+            }
+        }
+
+        for (; j < xs.size(); j++) {
+            out[j] = this->compute(xs[j]);
+        }
+    }
+};
+
 /** A cute lagrange interpolation model implementation */
 template<typename NumericType>
 class Lagrange {
-private:
+public:
+    // One node: its x, its control point and its barycentric weight
     struct LagrangeBasis {
         float x;
-        NumericType control_point; // needs to have addition & scalar mult
+        float weight; // barycentric weight 1 / prod_{j != i} (x_i - x_j), scaled so the largest is +-1
+        NumericType control_point; // needs to have addition & scalar mult, kept last so aligned points pad less
 
         void print() const {
             std::cout << "(" << this->x << ", " << this->control_point << ")";
@@ -127,62 +467,437 @@ private:
         }
     };
 
+    // The interpolant and its first two derivatives at one x
+    struct Derivatives {
+        NumericType value;
+        NumericType first;
+        NumericType second;
+    };
+
+private:
     float m_x_min;
     float m_x_max;
+    long m_weight_exponent; // the true weight of node i is m_basis_pairs[i].weight * 2^m_weight_exponent
     std::vector<LagrangeBasis> m_basis_pairs;
+
+    // Computes every node's barycentric weight in O(n^2), once. The raw products over- or underflow
+    // even a double for a few hundred nodes, so each one is carried as mantissa * 2^exponent and the
+    // weights are only brought back to floats after dividing out a common power of two; the common
+    // factor cancels between the numerator and the denominator of the barycentric formula anyway.
+    void compute_weights() {
+        const int num_values = (int) this->m_basis_pairs.size();
+        std::vector<double> mantissas(num_values);
+        std::vector<long> exponents(num_values);
+        long max_exponent = 0;
+
+        for (int i = 0; i < num_values; i++) {
+            mantissas[i] = this->inverse_node_product(this->m_basis_pairs[i].x, i, exponents[i]);
+            max_exponent = i == 0 ? exponents[i] : std::max(max_exponent, exponents[i]);
+        }
+
+        for (int i = 0; i < num_values; i++) {
+            this->m_basis_pairs[i].weight = (float) std::ldexp(mantissas[i], (int) std::max<long>(exponents[i] - max_exponent, -1100));
+        }
+        this->m_weight_exponent = max_exponent;
+        this->renormalize_weights();
+    }
+
+    // 1 / prod_{j != skip} (x - x_j) as mantissa * 2^exponent, the mantissa being returned
+    double inverse_node_product(const float x, const int skip, long& exponent) const {
+        const int num_values = (int) this->m_basis_pairs.size();
+        double mantissa = 1.0;
+        long product_exponent = 0;
+        for (int j = 0; j < num_values; j++) {
+            if (j != skip) {
+                int e;
+                mantissa = std::frexp(mantissa * ((double) x - (double) this->m_basis_pairs[j].x), &e);
+                product_exponent += e;
+            }
+        }
+
+        int e;
+        const double inverse = std::frexp(1.0 / mantissa, &e);
+        exponent = e - product_exponent;
+        return inverse;
+    }
+
+    // Scales the stored weights by a power of two (exact in floating point) so the largest sits in
+    // [0.5, 1), folding the factor into m_weight_exponent. Keeps incremental updates from drifting
+    // towards float overflow or underflow.
+    void renormalize_weights() {
+        float largest = 0.f;
+        for (const LagrangeBasis& basis_pair : this->m_basis_pairs) {
+            largest = std::max(largest, std::abs(basis_pair.weight));
+        }
+
+        if (largest == 0.f || !std::isfinite(largest)) {
+            return;
+        }
+
+        int e;
+        std::frexp(largest, &e);
+        for (LagrangeBasis& basis_pair : this->m_basis_pairs) {
+            basis_pair.weight = std::ldexp(basis_pair.weight, -e);
+        }
+        this->m_weight_exponent += e;
+    }
+
+    // Recomputes the domain after the node that defined it was removed
+    void recompute_domain() {
+        this->m_x_min = std::numeric_limits<float>::max();
+        this->m_x_max = std::numeric_limits<float>::lowest();
+        for (const LagrangeBasis& basis_pair : this->m_basis_pairs) {
+            this->m_x_max = std::max(this->m_x_max, basis_pair.x);
+            this->m_x_min = std::min(this->m_x_min, basis_pair.x);
+        }
+    }
+
+    // The interpolant and, up to ORDER, its derivatives at x in O(n). Summing t_i = w_i / (x - x_i) and
+    // differentiating N / D directly cancels catastrophically next to a node, where one t_i dwarfs the
+    // rest. So the nearest node k is split off first: multiplying through by h = x - x_k gives
+    //     p = y_k + A / B,   A = h S(x),   B = w_k + h D(x)
+    // with S = sum_{i != k} t_i (y_i - y_k) and D = sum_{i != k} t_i both smooth around x_k. Their
+    // derivatives only add factors 1 / (x - x_i), so one loop gathers everything, and at h = 0 this is
+    // exactly the node formula p'(x_k) = sum_{i != k} (w_i / w_k) (y_i - y_k) / (x_k - x_i).
+    template <int ORDER>
+    Derivatives evaluate_derivatives(float x) const {
+        const int num_values = (int) this->m_basis_pairs.size();
+        int k = 0;
+        for (int i = 1; i < num_values; i++) {
+            k = std::abs(x - this->m_basis_pairs[i].x) < std::abs(x - this->m_basis_pairs[k].x) ? i : k;
+        }
+
+        const LagrangeBasis& nearest = this->m_basis_pairs[k];
+        const NumericType zero = 0.f * nearest.control_point;
+        NumericType numerator[3] = { zero, zero, zero };
+        float denominator[3] = { 0.f, 0.f, 0.f };
+
+        for (int i = 0; i < num_values; i++) {
+            if (i == k) {
+                continue;
+            }
+
+            const LagrangeBasis& cur_basis = this->m_basis_pairs[i];
+            const float inverse = 1.f / (x - cur_basis.x);
+            const NumericType offset = cur_basis.control_point - nearest.control_point;
+            float term = cur_basis.weight * inverse;
+            for (int m = 0; m <= ORDER; m++) {
+                denominator[m] += term;
+                numerator[m] = numerator[m] + term * offset;
+                term *= inverse;
+            }
+        }
+
+        const float h = x - nearest.x;
+        const float b = nearest.weight + h * denominator[0];
+        const NumericType rise = (1.f / b) * (h * numerator[0]);  // A / B
+        Derivatives out = { nearest.control_point + rise, zero, zero };
+        if constexpr (ORDER >= 1) {
+            const float b_first = denominator[0] - h * denominator[1];
+            out.first = (1.f / b) * ((numerator[0] - h * numerator[1]) - b_first * rise);
+            if constexpr (ORDER >= 2) {
+                const float b_second = 2.f * (h * denominator[2] - denominator[1]);
+                const NumericType a_second = 2.f * (h * numerator[2] - numerator[1]);
+                out.second = (1.f / b) * (a_second - (2.f * b_first) * out.first - b_second * rise);
+            }
+        }
+
+        return out;
+    }
+
+    // Where evaluate_lanes writes: the values and, up to ORDER, the first and second derivatives
+    typedef std::array<NumericType*, 3> Outputs;
+
+    // Barycentric evaluation of LANES queries at once: every node is broadcast against a vector of
+    // query x values, with one accumulator per control point component. For ORDER 0 a lane that hits
+    // a node exactly divides by zero, so the hit is remembered and that lane is patched afterwards;
+    // with derivatives every lane splits off its own nearest node as in evaluate_derivatives, which
+    // needs no patching.
+    template <size_t LANES, int ORDER>
+    __attribute__((always_inline)) inline void evaluate_lanes(const float* xs, const Outputs& out) const {
+        typedef ControlPointLanes<NumericType> Lanes;
+        typedef typename QueryLanes<LANES>::floats floats;
+        typedef typename QueryLanes<LANES>::ints ints;
+        constexpr size_t C = Lanes::components;
+
+        floats x;
+        std::memcpy(&x, xs, sizeof(x));
+        const int num_values = (int) this->m_basis_pairs.size();
+
+        if constexpr (ORDER == 0) {
+            floats denominator = {};
+            floats numerator[C] = {};
+            ints hit = {}; // 1 + index of the node a lane sits on, 0 if none
+
+            for (int i = 0; i < num_values; i++) {
+                const LagrangeBasis& cur_basis = this->m_basis_pairs[i];
+                const floats diff = x - cur_basis.x;
+                hit = (diff == 0.f) ? (hit - hit + (i + 1)) : hit;
+
+                const floats term = cur_basis.weight / diff;
+                denominator += term;
+                for (size_t c = 0; c < C; c++) {
+                    numerator[c] += term * Lanes::get(cur_basis.control_point, c);
+                }
+            }
+
+            const floats scale = 1.f / denominator;
+            for (size_t l = 0; l < LANES; l++) {
+                if (hit[l] != 0) {
+                    out[0][l] = this->m_basis_pairs[hit[l] - 1].control_point;
+                    continue;
+                }
+
+                for (size_t c = 0; c < C; c++) {
+                    Lanes::set(out[0][l], c, scale[l] * numerator[c][l]);
+                }
+            }
+        } else {
+            // nearest node of every lane
+            ints k = {};
+            floats best = x - this->m_basis_pairs[0].x;
+            best = best < 0.f ? -best : best;
+            for (int i = 1; i < num_values; i++) {
+                floats distance = x - this->m_basis_pairs[i].x;
+                distance = distance < 0.f ? -distance : distance;
+                const ints closer = distance < best;
+                best = closer ? distance : best;
+                k = closer ? (k - k + i) : k;
+            }
+
+            floats nearest_x;
+            floats nearest_weight;
+            floats nearest_y[C];
+            for (size_t l = 0; l < LANES; l++) {
+                const LagrangeBasis& nearest = this->m_basis_pairs[k[l]];
+                nearest_x[l] = nearest.x;
+                nearest_weight[l] = nearest.weight;
+                for (size_t c = 0; c < C; c++) {
+                    nearest_y[c][l] = Lanes::get(nearest.control_point, c);
+                }
+            }
+
+            floats denominator[ORDER + 1] = {};
+            floats numerator[ORDER + 1][C] = {};
+            for (int i = 0; i < num_values; i++) {
+                const LagrangeBasis& cur_basis = this->m_basis_pairs[i];
+                const floats diff = x - cur_basis.x;
+                const floats inverse = (k == i) ? floats{} : 1.f / diff;
+                floats term = cur_basis.weight * inverse;
+                for (int m = 0; m <= ORDER; m++) {
+                    denominator[m] += term;
+                    for (size_t c = 0; c < C; c++) {
+                        numerator[m][c] += term * (Lanes::get(cur_basis.control_point, c) - nearest_y[c]);
+                    }
+                    term *= inverse;
+                }
+            }
+
+            const floats h = x - nearest_x;
+            const floats b = nearest_weight + h * denominator[0];
+            const floats inverse_b = 1.f / b;
+            const floats b_first = denominator[0] - h * denominator[1];
+            for (size_t c = 0; c < C; c++) {
+                const floats rise = inverse_b * (h * numerator[0][c]);
+                const floats first = inverse_b * ((numerator[0][c] - h * numerator[1][c]) - b_first * rise);
+                floats second = {};
+                if constexpr (ORDER >= 2) {
+                    const floats b_second = 2.f * (h * denominator[2] - denominator[1]);
+                    const floats a_second = 2.f * (h * numerator[2][c] - numerator[1][c]);
+                    second = inverse_b * (a_second - (2.f * b_first) * first - b_second * rise);
+                }
+
+                for (size_t l = 0; l < LANES; l++) {
+                    Lanes::set(out[0][l], c, nearest_y[c][l] + rise[l]);
+                    Lanes::set(out[1][l], c, first[l]);
+                    if constexpr (ORDER >= 2) {
+                        Lanes::set(out[2][l], c, second[l]);
+                    }
+                }
+            }
+        }
+    }
+
+#if LAGRANGE_X86_SIMD
+    template <int ORDER>
+    __attribute__((target("avx2")))
+    void evaluate_lanes_avx2(const float* xs, const Outputs& out) const {
+        this->evaluate_lanes<8, ORDER>(xs, out);
+    }
+
+    template <int ORDER>
+    __attribute__((target("avx512f")))
+    void evaluate_lanes_avx512(const float* xs, const Outputs& out) const {
+        this->evaluate_lanes<16, ORDER>(xs, out);
+    }
+#endif
+
+    // Evaluates xs[begin, end) into out[.][begin, end), a vector of queries at a time where the control
+    // point type allows it. `x_of(j)` gives the j-th query, so ranges never have to be materialized.
+    template <int ORDER, typename XOf>
+    void evaluate_span(size_t begin, size_t end, XOf&& x_of, const Outputs& out) const {
+        auto shifted = [&out](size_t by) {
+            return Outputs { out[0] + by, ORDER >= 1 ? out[1] + by : nullptr, ORDER >= 2 ? out[2] + by : nullptr };
+        };
+
+        if constexpr (ControlPointLanes<NumericType>::components > 0) {
+            size_t lanes = 4;
+#if LAGRANGE_X86_SIMD
+            lanes = cpu_has_avx512f() ? 16 : (cpu_has_avx2() ? 8 : 4);
+#endif
+            float block[16];
+            for (; begin + lanes <= end; begin += lanes) {
+                for (size_t l = 0; l < lanes; l++) {
+                    block[l] = x_of(begin + l);
+                }
+
+#if LAGRANGE_X86_SIMD
+                if (lanes == 16) {
+                    this->evaluate_lanes_avx512<ORDER>(block, shifted(begin));
+                    continue;
+                }
+                if (lanes == 8) {
+                    this->evaluate_lanes_avx2<ORDER>(block, shifted(begin));
+                    continue;
+                }
+#endif
+                this->evaluate_lanes<4, ORDER>(block, shifted(begin));
+            }
+        }
+
+        for (; begin < end; begin++) {
+            if constexpr (ORDER == 0) {
+                out[0][begin] = this->compute(x_of(begin));
+            } else {
+                const Derivatives d = this->evaluate_derivatives<ORDER>(x_of(begin));
+                out[0][begin] = d.value;
+                out[1][begin] = d.first;
+                if constexpr (ORDER >= 2) {
+                    out[2][begin] = d.second;
+                }
+            }
+        }
+    }
+
+    // Splits [0, n) into one contiguous slice per thread, the calling thread taking the first
+    template <int ORDER, typename XOf>
+    void evaluate_parallel(size_t n, XOf&& x_of, const Outputs& out, size_t threads) const {
+        // below a few thousand queries per thread, spawning costs more than it saves
+        threads = std::max<size_t>(1, std::min(threads, n / 4096));
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++) {
+            pool.emplace_back([&, t]() {
+                this->evaluate_span<ORDER>(n * t / threads, n * (t + 1) / threads, x_of, out);
+            });
+        }
+
+        this->evaluate_span<ORDER>(0, n / threads, x_of, out);
+        for (std::thread& worker : pool) {
+            worker.join();
+        }
+    }
+
 public:
     Lagrange(const std::vector<float>& x_values, const std::vector<NumericType>& control_pts) {
         const int num_values = (int) x_values.size();
         this->m_basis_pairs = std::vector<LagrangeBasis>(num_values);
         this->m_x_min = std::numeric_limits<float>::max();
-        this->m_x_max = std::numeric_limits<float>::min();
+        this->m_x_max = std::numeric_limits<float>::lowest();
 
         for (int i = 0; i < num_values; i++) {
             LagrangeBasis& basis_pair = this->m_basis_pairs[i];
             basis_pair.x = x_values[i];
+            basis_pair.control_point = control_pts[i];
 
             this->m_x_max = std::max(this->m_x_max, basis_pair.x);
             this->m_x_min = std::min(this->m_x_min, basis_pair.x);
-
-            float denom_product = 1.f;
-            for (int j = 0; j < num_values; j++) {
-                const bool neq_gate = j != i;
-                denom_product *= (basis_pair.x - x_values[j]) * neq_gate + !neq_gate;
-            }
-
-            basis_pair.control_point = (1.f/denom_product) * control_pts[i];
         }
+
+        this->compute_weights();
     }
 
     template<typename Iter>
     Lagrange(const Iter& start_x, const Iter& end_x, const Iter& start_y, const Iter& end_y) {
-        this->m_x_max = std::numeric_limits<float>::max();
-        this->m_x_min = std::numeric_limits<float>::min();
+        this->m_x_max = std::numeric_limits<float>::lowest();
+        this->m_x_min = std::numeric_limits<float>::max();
 
         // We assume both of these iterators travel some buffer of the same length
         Iter y_iter = start_y;
         for (Iter x_iter = start_x; x_iter != end_x; x_iter++) {
             LagrangeBasis basis_pair;
             basis_pair.x = (float) *x_iter;
-         
-            float denom_product = 1;
-            for (Iter x_dupe = start_x; x_dupe != end_x; x_dupe++) {
-                const bool neq_gate = x_dupe != x_iter;
-                denom_product *= (basis_pair.x - (*x_dupe)) * neq_gate + !neq_gate;
-            }
-
-            basis_pair.control_point = (*y_iter) * (1.f / denom_product);
+            basis_pair.control_point = *y_iter;
+            this->m_x_max = std::max(this->m_x_max, basis_pair.x);
+            this->m_x_min = std::min(this->m_x_min, basis_pair.x);
             this->m_basis_pairs.push_back(basis_pair);
             y_iter = std::next(y_iter);
         }
+
+        this->compute_weights();
     }
 
     Lagrange(Lagrange<NumericType>&& other) {
         this->m_x_max = other.m_x_max;
         this->m_x_min = other.m_x_min;
+        this->m_weight_exponent = other.m_weight_exponent;
         this->m_basis_pairs = std::move(other.m_basis_pairs);
     }
 
+    // Adds the node (x, y) in O(n): every existing weight picks up a factor 1 / (x_i - x), the new
+    // weight is a single O(n) product. x must not already be a node.
+    void add_point(float x, const NumericType& y) {
+        for (const LagrangeBasis& basis_pair : this->m_basis_pairs) {
+            if (basis_pair.x == x) {
+                std::cout << "Lagrange::add_point was given an x that is already a node" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        long exponent;
+        const double mantissa = this->inverse_node_product(x, -1, exponent);
+        if (this->m_basis_pairs.empty()) {
+            this->m_weight_exponent = exponent;
+        }
+
+        for (LagrangeBasis& basis_pair : this->m_basis_pairs) {
+            basis_pair.weight = (float) ((double) basis_pair.weight / ((double) basis_pair.x - (double) x));
+        }
+
+        LagrangeBasis basis_pair;
+        basis_pair.x = x;
+        basis_pair.control_point = y;
+        basis_pair.weight = (float) std::ldexp(mantissa, (int) std::clamp<long>(exponent - this->m_weight_exponent, -1100, 1100));
+        this->m_basis_pairs.push_back(basis_pair);
+
+        this->m_x_max = std::max(this->m_x_max, x);
+        this->m_x_min = std::min(this->m_x_min, x);
+        this->renormalize_weights();
+    }
+
+    // Removes the i-th node in O(n): every remaining weight gets its factor 1 / (x_j - x_i) back out
+    void remove_point(size_t i) {
+        if (i >= this->m_basis_pairs.size()) {
+            std::cout << "Lagrange::remove_point was given an index past the last node" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        const float x = this->m_basis_pairs[i].x;
+        this->m_basis_pairs.erase(this->m_basis_pairs.begin() + i);
+        for (LagrangeBasis& basis_pair : this->m_basis_pairs) {
+            basis_pair.weight = (float) ((double) basis_pair.weight * ((double) basis_pair.x - (double) x));
+        }
+
+        if (x == this->m_x_min || x == this->m_x_max) {
+            this->recompute_domain();
+        }
+        this->renormalize_weights();
+    }
+
+    // Number of nodes this Lagrange instance interpolates
+    size_t size() const {
+        return this->m_basis_pairs.size();
+    }
+
     // Returns the minimum and maximum float this Lagrange instance
     // was defined over (has an associated control point with)
     // as an std::pair<float, float> = {min, max}
@@ -190,8 +905,40 @@ public:
         return {this->m_x_min, this->m_x_max};
     }
 
-    // Compute 
+    // The second (true) barycentric formula over any set of nodes whose weights share a scale:
+    //     p(x) = sum_i (w_i / (x - x_i)) y_i / sum_i (w_i / (x - x_i))
+    // A query sitting exactly on a node returns that node's control point.
+    static NumericType compute_over(std::span<const LagrangeBasis> basis, float x) {
+        NumericType numerator = 0 * basis[0].control_point;
+        float denominator = 0.f;
+
+        for (const LagrangeBasis& cur_basis : basis) {
+            const float diff = x - cur_basis.x;
+            if (diff == 0.f) {
+                return cur_basis.control_point;
+            }
+
+            const float term = cur_basis.weight / diff;
+            numerator = numerator + term * cur_basis.control_point;
+            denominator += term;
+        }
+
+        return (1.f / denominator) * numerator;
+    }
+
+    // Computes the interpolant at x in O(n) with the barycentric formula, see compute_over
     NumericType compute(float x) const {
+        return Lagrange::compute_over(this->m_basis_pairs, x);
+    }
+
+    // The nodes in insertion order, weights included
+    std::span<const LagrangeBasis> basis() const {
+        return this->m_basis_pairs;
+    }
+
+    // Computes the interpolant at x straight from the Lagrange basis polynomials,
+    // sum_i y_i prod_{j != i} (x - x_j) / (x_i - x_j), in O(n^2). Kept as a reference for compute.
+    NumericType compute_direct(float x) const {
         const int num_values = (int) this->m_basis_pairs.size();
         NumericType output = 0 * this->m_basis_pairs[0].control_point;
 
@@ -201,8 +948,8 @@ public:
 
             for (int j = 0; j < num_values; j++) {
                 const LagrangeBasis& other_basis = this->m_basis_pairs[j];
-                const bool neq_gate = cur_basis.x != other_basis.x;
-                product *= (x - other_basis.x) * neq_gate + !neq_gate;
+                const bool neq_gate = i != j;
+                product *= neq_gate ? (x - other_basis.x) / (cur_basis.x - other_basis.x) : 1.f;
             }
 
             output = output + product * cur_basis.control_point;
@@ -211,29 +958,76 @@ public:
         return output;
     }
 
+    // Computes the interpolant at every xs[j] into out[j], `out` being at least as long as `xs`. Batches
+    // of queries go through SIMD lanes for float and Point<D> control points and large sets are split
+    // across `threads` threads. Nothing is allocated.
+    void compute_batch(std::span<const float> xs, std::span<NumericType> out, size_t threads = 1) const {
+        if (out.size() < xs.size()) {
+            std::cout << "Lagrange::compute_batch was given an output shorter than its input" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        this->evaluate_parallel<0>(xs.size(), [xs](size_t j) { return xs[j]; }, Outputs { out.data(), nullptr, nullptr }, threads);
+    }
+
+    // Computes out.size() evenly spaced points of [x_min, x_max] into `out`, like compute_range but
+    // batched, threaded and without allocating
+    void compute_range(float x_min, float x_max, std::span<NumericType> out, size_t threads = 1) const {
+        const size_t num_points = out.size();
+        const float partition = num_points > 1 ? (x_max - x_min) / (num_points - 1) : 0.f;
+        this->evaluate_parallel<0>(num_points, [=](size_t j) {
+            return j + 1 == num_points ? x_max : x_min + partition * j;
+        }, Outputs { out.data(), nullptr, nullptr }, threads);
+    }
+
+    // The interpolant and its derivative at x, analytically in one O(n) pass (see evaluate_derivatives)
+    std::pair<NumericType, NumericType> value_and_derivative(float x) const {
+        const Derivatives d = this->evaluate_derivatives<1>(x);
+        return { d.value, d.first };
+    }
+
+    // The interpolant and its first two derivatives at x, analytically in one O(n) pass
+    Derivatives value_and_derivatives(float x) const {
+        return this->evaluate_derivatives<2>(x);
+    }
+
+    // value_and_derivative for every xs[j] into values[j] and derivatives[j]; batched, threaded and
+    // allocation free like compute_batch
+    void value_and_derivative_batch(std::span<const float> xs, std::span<NumericType> values,
+                                    std::span<NumericType> derivatives, size_t threads = 1) const {
+        if (values.size() < xs.size() || derivatives.size() < xs.size()) {
+            std::cout << "Lagrange::value_and_derivative_batch was given an output shorter than its input" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        this->evaluate_parallel<1>(xs.size(), [xs](size_t j) { return xs[j]; },
+            Outputs { values.data(), derivatives.data(), nullptr }, threads);
+    }
+
+    // value_and_derivatives for every xs[j] into values[j], firsts[j] and seconds[j]
+    void value_and_derivatives_batch(std::span<const float> xs, std::span<NumericType> values,
+                                     std::span<NumericType> firsts, std::span<NumericType> seconds, size_t threads = 1) const {
+        if (values.size() < xs.size() || firsts.size() < xs.size() || seconds.size() < xs.size()) {
+            std::cout << "Lagrange::value_and_derivatives_batch was given an output shorter than its input" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        this->evaluate_parallel<2>(xs.size(), [xs](size_t j) { return xs[j]; },
+            Outputs { values.data(), firsts.data(), seconds.data() }, threads);
+    }
+
     // Compute an entire set
     std::vector<NumericType> compute_all(const std::vector<float>& x_set) const {
         std::vector<NumericType> results(x_set.size());
-        for (int i = 0; i < x_set.size(); i++) {
-            results[i] = this->compute(x_set[i]);
-        }
-
+        this->compute_batch(x_set, results);
         return results;
     }
 
 
     // Computes num_points number of points in the linear space
     std::vector<NumericType> compute_range(float x_min, float x_max, int num_points) {
-        const float partition = (x_max - x_min) / (num_points - 1);
-        float current = x_min;
         std::vector<NumericType> range_computations(num_points);
-
-        for (int i = 0; i < num_points; i++) {
-            range_computations[i] = this->compute(current);
-            current += partition;
-        }
-
-        range_computations[num_points - 1] = this->compute(x_max);
+        this->compute_range(x_min, x_max, range_computations);
         return range_computations;
     }
 
@@ -249,10 +1043,11 @@ public:
         return sum / abs(sum);
     }
 
-    // Approximates the derivative at some point x along this Lagrangian curve
+    // The derivative at some point x along this Lagrangian curve. Now exact, see value_and_derivative;
+    // epsilon is only still validated so existing callers keep behaving the same on bad input.
     NumericType approximate_derivative(float x, float epsilon=0.001f) {
         Lagrange::epsilon_check(epsilon);
-        return (this->compute(x + epsilon) - this->compute(x)) / epsilon;
+        return this->value_and_derivative(x).second;
     }
 
     // Returns the slope between two points along this Lagrangian curve given an x1 and x2
@@ -260,13 +1055,580 @@ public:
         return (this->compute(x2) - this->compute(x1)) / (x2 - x1);
     }
 
+    // Interpolates f at n Chebyshev points of [a, b], see chebyshev_nodes
+    template <typename F>
+    static Lagrange at_chebyshev_nodes(int n, float a, float b, F&& f) {
+        const std::vector<float> nodes = chebyshev_nodes(n, a, b);
+        std::vector<NumericType> control_pts;
+        for (const float x : nodes) {
+            control_pts.push_back(f(x));
+        }
+
+        return Lagrange(nodes, control_pts);
+    }
+
+    // The same polynomial as a Chebyshev series on [a, b], in O(n^2) once: the interpolant is
+    // sampled at the n Chebyshev points of the first kind and a discrete cosine transform turns the
+    // samples into coefficients. Exact up to rounding, the interpolant having degree n - 1.
+    ChebyshevSeries<NumericType> to_chebyshev(float a, float b) const {
+        const int n = (int) this->m_basis_pairs.size();
+        const double pi = std::acos(-1.0);
+        std::vector<NumericType> samples;
+        for (int k = 0; k < n; k++) {
+            const double t = std::cos(pi * (k + 0.5) / n);
+            samples.push_back(this->compute((float) (0.5 * (a + b) + 0.5 * (b - a) * t)));
+        }
+
+        std::vector<NumericType> coefficients;
+        for (int j = 0; j < n; j++) {
+            NumericType sum = 0.f * samples[0];
+            for (int k = 0; k < n; k++) {
+                sum = sum + (float) std::cos(pi * j * (k + 0.5) / n) * samples[k];
+            }
+            coefficients.push_back((j == 0 ? 1.f : 2.f) / n * sum);
+        }
+
+        return ChebyshevSeries<NumericType>(a, b, std::move(coefficients));
+    }
+
+    // to_chebyshev over this interpolant's own domain
+    ChebyshevSeries<NumericType> to_chebyshev() const {
+        return this->to_chebyshev(this->m_x_min, this->m_x_max);
+    }
+
+    // The same polynomial in plain powers of x, in O(n^2) once. Goes through the Chebyshev series:
+    // every T_j(t) is expanded into powers of t, then t = alpha x + beta is substituted back in.
+    MonomialSeries<NumericType> to_monomial() const {
+        const ChebyshevSeries<NumericType> series = this->to_chebyshev();
+        const std::vector<NumericType>& c = series.coefficients();
+        const int n = (int) c.size();
+
+        // powers of t: d_m = sum_j c_j [t^m] T_j(t), with T_{j+1} = 2t T_j - T_{j-1}
+        std::vector<double> previous(n, 0.0);
+        std::vector<double> current(n, 0.0);
+        current[0] = 1.0;
+        std::vector<NumericType> in_t(n, 0.f * c[0]);
+        for (int j = 0; j < n; j++) {
+            for (int m = 0; m <= j; m++) {
+                in_t[m] = in_t[m] + (float) current[m] * c[j];
+            }
+
+            // T_1 = t T_0, every later one 2t T_j - T_{j-1}
+            std::vector<double> next(n, 0.0);
+            for (int m = 1; m < n; m++) {
+                next[m] = (j == 0 ? 1.0 : 2.0) * current[m - 1] - (j > 0 ? previous[m] : 0.0);
+            }
+            next[0] = j > 0 ? -previous[0] : 0.0;
+            previous = std::move(current);
+            current = std::move(next);
+        }
+
+        // Horner on polynomials: q <- q * (alpha x + beta) + d_m
+        const float alpha = 2.f / (this->m_x_max - this->m_x_min);
+        const float beta = -(this->m_x_max + this->m_x_min) / (this->m_x_max - this->m_x_min);
+        std::vector<NumericType> in_x(n, 0.f * c[0]);
+        in_x[0] = in_t[n - 1];
+        for (int m = n - 2; m >= 0; m--) {
+            for (int k = n - 1; k >= 1; k--) {
+                in_x[k] = beta * in_x[k] + alpha * in_x[k - 1];
+            }
+            in_x[0] = beta * in_x[0] + in_t[m];
+        }
+
+        return MonomialSeries<NumericType>(std::move(in_x));
+    }
+
     // Computes num_points number of points in the linear space [this->range().first, this->range().second]
     std::vector<NumericType> compute_range(int num_points) {
         return this->compute_range(this->m_x_min, this->m_x_max, num_points);
     }
 };
 
-int main() {
+/** Piecewise Lagrange interpolation for large control sets. Every interval between neighbouring nodes
+ * gets its own low order interpolant through the `order` + 1 nodes around it, so evaluating costs
+ * O(order) after finding the interval, and the Runge oscillations of one global polynomial through
+ * thousands of nodes never build up. The windows (nodes, control points and barycentric weights,
+ * taken from a Lagrange over each window) are stored back to back, so one evaluation reads one
+ * contiguous run of memory. Intervals are found by direct indexing when the nodes are evenly spaced
+ * and by binary search otherwise. */
+template<typename NumericType>
+class PiecewiseLagrange {
+private:
+    typedef typename Lagrange<NumericType>::LagrangeBasis LagrangeBasis;
+
+    size_t m_window;                        // nodes per segment, order + 1
+    std::vector<float> m_breaks;            // sorted node x values, segment s spans [m_breaks[s], m_breaks[s + 1]]
+    std::vector<LagrangeBasis> m_segments;  // segment s uses m_segments[s * m_window, (s + 1) * m_window)
+    bool m_uniform;
+    float m_inverse_step;                   // 1 / node spacing, when m_uniform
+
+    // Index of the segment whose interval holds x, the first or last one outside the domain
+    size_t segment_of(float x) const {
+        const size_t last = this->m_breaks.size() > 1 ? this->m_breaks.size() - 2 : 0;
+        if (this->m_uniform) {
+            const float position = (x - this->m_breaks[0]) * this->m_inverse_step;
+            size_t s = position <= 0.f ? 0 : std::min(last, (size_t) position);
+            // rounding in the step can put x one segment off either way
+            s = (s > 0 && x < this->m_breaks[s]) ? s - 1 : s;
+            s = (s < last && x > this->m_breaks[s + 1]) ? s + 1 : s;
+            return s;
+        }
+
+        const size_t upper = std::upper_bound(this->m_breaks.begin(), this->m_breaks.end(), x) - this->m_breaks.begin();
+        return std::min(last, upper > 0 ? upper - 1 : 0);
+    }
+
+public:
+    PiecewiseLagrange(const std::vector<float>& x_values, const std::vector<NumericType>& control_pts, int order = 3) {
+        const size_t n = x_values.size();
+        if (n == 0 || order < 1) {
+            std::cout << "PiecewiseLagrange needs at least one node and an order of at least 1" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::vector<size_t> sorted(n);
+        for (size_t i = 0; i < n; i++) {
+            sorted[i] = i;
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [&x_values](size_t a, size_t b) {
+            return x_values[a] < x_values[b];
+        });
+
+        for (size_t i = 0; i < n; i++) {
+            this->m_breaks.push_back(x_values[sorted[i]]);
+            if (i > 0 && this->m_breaks[i] == this->m_breaks[i - 1]) {
+                std::cout << "PiecewiseLagrange was given the same x twice" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        // even spacing, up to float rounding of the node positions. Every node within a quarter step
+        // of its grid position keeps the direct index at most one segment off.
+        const float step = n > 1 ? (this->m_breaks[n - 1] - this->m_breaks[0]) / (n - 1) : 1.f;
+        this->m_uniform = true;
+        for (size_t i = 0; i < n; i++) {
+            const float grid = this->m_breaks[0] + i * step;
+            this->m_uniform = this->m_uniform && std::abs(this->m_breaks[i] - grid) <= 0.25f * step;
+        }
+        this->m_inverse_step = 1.f / step;
+
+        // the window of segment s is centred on it and slides inwards at the ends
+        this->m_window = std::min(n, (size_t) order + 1);
+        const size_t segments = n > 1 ? n - 1 : 1;
+        this->m_segments.reserve(segments * this->m_window);
+        std::vector<float> window_x(this->m_window);
+        std::vector<NumericType> window_y(this->m_window);
+        for (size_t s = 0; s < segments; s++) {
+            const size_t behind = (this->m_window - 1) / 2;
+            const size_t first = std::min(s > behind ? s - behind : 0, n - this->m_window);
+            for (size_t w = 0; w < this->m_window; w++) {
+                window_x[w] = this->m_breaks[first + w];
+                window_y[w] = control_pts[sorted[first + w]];
+            }
+
+            const Lagrange<NumericType> local(window_x, window_y);
+            for (const LagrangeBasis& node : local.basis()) {
+                this->m_segments.push_back(node);
+            }
+        }
+    }
+
+    // Returns the minimum and maximum node as an std::pair<float, float> = {min, max}
+    std::pair<float, float> domain() const {
+        return { this->m_breaks.front(), this->m_breaks.back() };
+    }
+
+    // Evaluates to true if segments are found by direct indexing rather than binary search
+    bool uniform() const {
+        return this->m_uniform;
+    }
+
+    // Number of local interpolants
+    size_t segments() const {
+        return this->m_segments.size() / this->m_window;
+    }
+
+    // Computes the piecewise interpolant at x, extrapolating the outer segments past the domain
+    NumericType compute(float x) const {
+        const size_t s = this->segment_of(x);
+        return Lagrange<NumericType>::compute_over(
+            std::span<const LagrangeBasis>(this->m_segments.data() + s * this->m_window, this->m_window), x);
+    }
+
+    // compute for every xs[j] into out[j], `out` being at least as long as `xs`
+    void compute_batch(std::span<const float> xs, std::span<NumericType> out) const {
+        if (out.size() < xs.size()) {
+            std::cout << "PiecewiseLagrange::compute_batch was given an output shorter than its input" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        for (size_t j = 0; j < xs.size(); j++) {
+            out[j] = this->compute(xs[j]);
+        }
+    }
+};
+
+/** Times `f` and prints it as "<label> took <n>ms" */
+template <typename F>
+double time_ms(const std::string& label, F&& f) {
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	const auto t1 = high_resolution_clock::now();
+	f();
+	const auto t2 = high_resolution_clock::now();
+
+	const double ms = duration<double, std::milli>(t2 - t1).count();
+	std::cout << label << " took " << ms << "ms" << std::endl;
+	return ms;
+}
+
+/** Interpolates Runge's function 1 / (1 + 25x^2) on n = 8 .. 4096 Chebyshev nodes and evaluates it at
+ * `queries` uniformly spread points, barycentric against the direct O(n^2) formula. The direct formula
+ * only gets as many queries as fit in ~1e9 inner iterations. */
+void run_benchmarks(int queries) {
+	auto runge = [](float x) { return 1.f / (1.f + 25.f * x * x); };
+
+	std::vector<float> xs(queries);
+	for (int q = 0; q < queries; q++) {
+		xs[q] = -1.f + 2.f * (q + 0.5f) / queries;
+	}
+
+	for (int n = 8; n <= 4096; n *= 2) {
+		std::cout << "\n[n = " << n << "]" << std::endl;
+		const std::vector<float> nodes = chebyshev_nodes(n, -1.f, 1.f);
+		std::vector<float> ys(n);
+		for (int i = 0; i < n; i++) {
+			ys[i] = runge(nodes[i]);
+		}
+
+		Lagrange<float> lag(nodes, ys);
+		float max_error = 0.f;
+		const double bary_ms = time_ms("compute x" + std::to_string(queries), [&]() {
+			for (int q = 0; q < queries; q++) {
+				max_error = std::max(max_error, std::abs(lag.compute(xs[q]) - runge(xs[q])));
+			}
+		});
+		std::cout << "  " << bary_ms * 1e6 / queries << "ns/query, max error " << max_error << std::endl;
+
+		const int direct_queries = (int) std::min<long long>(queries, std::max<long long>(1, 1'000'000'000LL / ((long long) n * n)));
+		float direct_error = 0.f;
+		const double direct_ms = time_ms("compute_direct x" + std::to_string(direct_queries), [&]() {
+			for (int q = 0; q < direct_queries; q++) {
+				const float x = xs[(long long) q * queries / direct_queries];
+				direct_error = std::max(direct_error, std::abs(lag.compute_direct(x) - runge(x)));
+			}
+		});
+		std::cout << "  " << direct_ms * 1e6 / direct_queries << "ns/query, max error " << direct_error << std::endl;
+	}
+}
+
+/** Times compute() on an n-node curve with Point<D> control points, `queries` queries */
+template <size_t D>
+void bench_point(int n, int queries) {
+	const std::vector<float> nodes = chebyshev_nodes(n, -1.f, 1.f);
+	std::vector<Point<D>> ys(n);
+	for (int i = 0; i < n; i++) {
+		for (size_t c = 0; c < D; c++) {
+			ys[i][c] = std::sin((c + 1) * nodes[i]);
+		}
+	}
+
+	const Lagrange<Point<D>> lag(nodes, ys);
+	Point<D> sum;
+	const double ms = time_ms("Point<" + std::to_string(D) + "> compute x" + std::to_string(queries), [&]() {
+		for (int q = 0; q < queries; q++) {
+			sum = sum + lag.compute(-1.f + 2.f * (q + 0.5f) / queries);
+		}
+	});
+	std::cout << "  " << ms * 1e6 / queries << "ns/query, checksum " << sum[0] << std::endl;
+}
+
+/** Evaluates n-node curves with float and Point<3> control points at `queries` points, one compute()
+ * per query against compute_batch on 1 .. max_threads threads */
+template <typename NumericType, typename MakePoint>
+void bench_batch(const std::string& name, int n, int queries, size_t max_threads, MakePoint&& make_point) {
+	std::cout << "\n[" << name << ", n = " << n << ", " << queries << " queries]" << std::endl;
+	const std::vector<float> nodes = chebyshev_nodes(n, -1.f, 1.f);
+	std::vector<NumericType> ys;
+	for (const float x : nodes) {
+		ys.push_back(make_point(x));
+	}
+
+	const Lagrange<NumericType> lag(nodes, ys);
+	std::vector<float> xs(queries);
+	for (int q = 0; q < queries; q++) {
+		xs[q] = -1.f + 2.f * (q + 0.5f) / queries;
+	}
+	xs[0] = nodes[0]; // make sure exact node hits go through the batch path too
+
+	std::vector<NumericType> single(queries);
+	std::vector<NumericType> batch(queries);
+	const double single_ms = time_ms("compute per query", [&]() {
+		for (int q = 0; q < queries; q++) {
+			single[q] = lag.compute(xs[q]);
+		}
+	});
+
+	for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+		const double batch_ms = time_ms("compute_batch on " + std::to_string(threads) + " thread(s)", [&]() {
+			lag.compute_batch(xs, batch, threads);
+		});
+
+		float max_diff = 0.f;
+		for (int q = 0; q < queries; q++) {
+			const NumericType diff = batch[q] - single[q];
+			for (size_t c = 0; c < ControlPointLanes<NumericType>::components; c++) {
+				max_diff = std::max(max_diff, std::abs(ControlPointLanes<NumericType>::get(diff, c)));
+			}
+		}
+		std::cout << "  " << single_ms / batch_ms << "x faster than per query, max difference " << max_diff << std::endl;
+	}
+}
+
+/** Exports interpolants of e^x sin(3x) on n = 4 .. 64 Chebyshev nodes to Chebyshev and monomial
+ * form and times `queries` evaluations of each against compute, with their max error against compute */
+void bench_series(int queries) {
+	auto f = [](float x) { return std::exp(x) * std::sin(3.f * x); };
+	std::vector<float> xs(queries);
+	for (int q = 0; q < queries; q++) {
+		xs[q] = -1.f + 2.f * (q + 0.5f) / queries;
+	}
+
+	for (int n = 4; n <= 64; n *= 2) {
+		std::cout << "\n[series, n = " << n << ", " << queries << " queries]" << std::endl;
+		const Lagrange<float> lag = Lagrange<float>::at_chebyshev_nodes(n, -1.f, 1.f, f);
+		const ChebyshevSeries<float> chebyshev = lag.to_chebyshev();
+		const MonomialSeries<float> monomial = lag.to_monomial();
+
+		auto run = [&](const std::string& name, auto&& evaluate) {
+			float max_error = 0.f;
+			float checksum = 0.f;
+			const double ms = time_ms(name, [&]() {
+				for (int q = 0; q < queries; q++) {
+					checksum += evaluate(xs[q]);
+				}
+			});
+			for (int q = 0; q < queries; q += 97) {
+				max_error = std::max(max_error, std::abs(evaluate(xs[q]) - lag.compute(xs[q])));
+			}
+			std::cout << "  " << ms * 1e6 / queries << "ns/query, max difference to compute " << max_error
+				<< " (checksum " << checksum << ")" << std::endl;
+		};
+
+		run("compute", [&](float x) { return lag.compute(x); });
+		run("ChebyshevSeries::compute", [&](float x) { return chebyshev.compute(x); });
+		run("MonomialSeries::compute", [&](float x) { return monomial.compute(x); });
+
+		std::vector<float> out(queries);
+		const double chebyshev_batch_ms = time_ms("ChebyshevSeries::compute_batch", [&]() {
+			chebyshev.compute_batch(xs, out);
+		});
+		const double monomial_batch_ms = time_ms("MonomialSeries::compute_batch", [&]() {
+			monomial.compute_batch(xs, out);
+		});
+		const double barycentric_batch_ms = time_ms("Lagrange::compute_batch", [&]() {
+			lag.compute_batch(xs, out);
+		});
+		std::cout << "  " << chebyshev_batch_ms * 1e6 / queries << " / " << monomial_batch_ms * 1e6 / queries
+			<< " / " << barycentric_batch_ms * 1e6 / queries << "ns/query (Chebyshev / monomial / barycentric)" << std::endl;
+	}
+}
+
+/** Value plus tangent of e^x sin(3x) interpolated on n Chebyshev nodes, at `queries` points: a forward
+ * difference of two computes (what approximate_derivative used to do) against the analytic single
+ * pass, scalar and batched, each with its max error against the true derivative */
+void bench_derivatives(int queries) {
+	auto f = [](double x) { return std::exp(x) * std::sin(3.0 * x); };
+	auto f_prime = [](double x) { return std::exp(x) * (std::sin(3.0 * x) + 3.0 * std::cos(3.0 * x)); };
+	std::vector<float> xs(queries);
+	for (int q = 0; q < queries; q++) {
+		xs[q] = -1.f + 2.f * (q + 0.5f) / queries;
+	}
+
+	for (const int n : { 16, 64, 256 }) {
+		std::cout << "\n[derivatives, n = " << n << ", " << queries << " queries]" << std::endl;
+		const Lagrange<float> lag = Lagrange<float>::at_chebyshev_nodes(n, -1.f, 1.f, [&](float x) { return (float) f(x); });
+		std::vector<float> values(queries);
+		std::vector<float> tangents(queries);
+		std::vector<float> curvatures(queries);
+
+		auto report = [&](double ms) {
+			double max_error = 0.0;
+			for (int q = 0; q < queries; q++) {
+				max_error = std::max(max_error, std::abs(tangents[q] - f_prime(xs[q])));
+			}
+			std::cout << "  " << ms * 1e6 / queries << "ns/query, max derivative error " << max_error << std::endl;
+		};
+
+		const float epsilon = 1e-3f;
+		report(time_ms("forward difference", [&]() {
+			for (int q = 0; q < queries; q++) {
+				values[q] = lag.compute(xs[q]);
+				tangents[q] = (lag.compute(xs[q] + epsilon) - values[q]) / epsilon;
+			}
+		}));
+		report(time_ms("value_and_derivative", [&]() {
+			for (int q = 0; q < queries; q++) {
+				std::tie(values[q], tangents[q]) = lag.value_and_derivative(xs[q]);
+			}
+		}));
+		report(time_ms("value_and_derivative_batch", [&]() {
+			lag.value_and_derivative_batch(xs, values, tangents);
+		}));
+		report(time_ms("value_and_derivatives_batch", [&]() {
+			lag.value_and_derivatives_batch(xs, values, tangents, curvatures);
+		}));
+	}
+}
+
+/** A live feed: keeps an n-node window on a stream of samples, every update being one add_point of the
+ * newest sample and one remove_point of the oldest, against rebuilding the whole model per update */
+void bench_incremental(int n, int updates) {
+	std::cout << "\n[sliding window of " << n << " nodes, " << updates << " updates]" << std::endl;
+	// golden ratio steps through (0, 1), mapped with Chebyshev density: any n consecutive samples are well spread
+	auto sample_x = [](long t) {
+		double u = t * 0.6180339887498949;
+		u -= std::floor(u);
+		return (float) -std::cos(3.14159265358979 * (0.001 + 0.998 * u));
+	};
+	auto sample_y = [](float x) { return std::sin(4.f * x); };
+
+	std::vector<float> xs;
+	std::vector<float> ys;
+	for (long t = 0; t < n; t++) {
+		xs.push_back(sample_x(t));
+		ys.push_back(sample_y(xs.back()));
+	}
+
+	Lagrange<float> lag(xs, ys);
+	long t = n;
+	const double incremental_ms = time_ms("add_point + remove_point x" + std::to_string(updates), [&]() {
+		for (int u = 0; u < updates; u++, t++) {
+			const float x = sample_x(t);
+			lag.remove_point(0);
+			lag.add_point(x, sample_y(x));
+		}
+	});
+	std::cout << "  " << updates / incremental_ms * 1000.0 << " inserts/s" << std::endl;
+
+	// the window the incremental model should now hold, built from scratch
+	xs.clear();
+	ys.clear();
+	for (long s = t - n; s < t; s++) {
+		xs.push_back(sample_x(s));
+		ys.push_back(sample_y(xs.back()));
+	}
+
+	const int rebuilds = std::max(1, updates / 100);
+	const double rebuild_ms = time_ms("full rebuild x" + std::to_string(rebuilds), [&]() {
+		for (int r = 0; r < rebuilds; r++) {
+			Lagrange<float> fresh(xs, ys);
+		}
+	});
+	std::cout << "  " << rebuilds / rebuild_ms * 1000.0 << " rebuilds/s" << std::endl;
+
+	const Lagrange<float> fresh(xs, ys);
+	float incremental_error = 0.f;
+	float fresh_error = 0.f;
+	for (int q = 0; q < 1000; q++) {
+		const float x = -0.99f + 1.98f * q / 999.f;
+		incremental_error = std::max(incremental_error, std::abs(lag.compute(x) - sample_y(x)));
+		fresh_error = std::max(fresh_error, std::abs(fresh.compute(x) - sample_y(x)));
+	}
+	std::cout << "  max error " << incremental_error << " after the updates, " << fresh_error << " rebuilt from scratch" << std::endl;
+}
+
+/** Runge's function through n nodes on a uniform and a jittered grid: one global Lagrange against
+ * piecewise local interpolants, in time per query and worst error over the domain */
+void bench_piecewise(int n, int queries) {
+	auto f = [](float x) { return 1.f / (1.f + 25.f * x * x); };
+	std::vector<float> queries_x(queries);
+	for (int q = 0; q < queries; q++) {
+		queries_x[q] = -1.f + 2.f * ((q * 0.6180339887498949) - std::floor(q * 0.6180339887498949));
+	}
+
+	for (const bool jittered : { false, true }) {
+		std::cout << "\n[piecewise, Runge on " << n << (jittered ? " jittered" : " uniform") << " nodes, " << queries << " queries]" << std::endl;
+		std::vector<float> xs(n);
+		std::vector<float> ys(n);
+		for (int i = 0; i < n; i++) {
+			const float jitter = jittered ? 0.4f * (float) std::sin(i * 12.9898) : 0.f;
+			xs[i] = -1.f + 2.f * (i + 0.5f + jitter) / n;
+			ys[i] = f(xs[i]);
+		}
+
+		std::vector<float> out(queries);
+		auto report = [&](double ms) {
+			float max_error = 0.f;
+			for (int q = 0; q < queries; q++) {
+				const float error = std::abs(out[q] - f(queries_x[q]));
+				max_error = std::isnan(error) ? std::numeric_limits<float>::infinity() : std::max(max_error, error);
+			}
+			std::cout << "  " << ms * 1e6 / queries << "ns/query, max error " << max_error << std::endl;
+		};
+
+		// the global polynomial is O(n) per query: time a slice of the queries and scale up
+		const int global_queries = std::max(1, queries / 100);
+		const Lagrange<float> global(xs, ys);
+		std::fill(out.begin(), out.end(), 0.f);
+		const double global_ms = time_ms("global Lagrange x" + std::to_string(global_queries), [&]() {
+			for (int q = 0; q < global_queries; q++) {
+				out[q] = global.compute(queries_x[q]);
+			}
+		});
+		float global_error = 0.f;
+		for (int q = 0; q < global_queries; q++) {
+			const float error = std::abs(out[q] - f(queries_x[q]));
+			global_error = std::isnan(error) ? std::numeric_limits<float>::infinity() : std::max(global_error, error);
+		}
+		std::cout << "  " << global_ms * 1e6 / global_queries << "ns/query, max error " << global_error << std::endl;
+
+		for (const int order : { 3, 5 }) {
+			const PiecewiseLagrange<float> piecewise(xs, ys, order);
+			report(time_ms("piecewise order " + std::to_string(order) + (piecewise.uniform() ? ", direct index" : ", binary search"), [&]() {
+				piecewise.compute_batch(queries_x, out);
+			}));
+		}
+	}
+
+	std::vector<Point<2>> curve(n);
+	std::vector<float> ts(n);
+	for (int i = 0; i < n; i++) {
+		ts[i] = (float) i / (n - 1);
+		curve[i] = Point<2>{ std::cos(6.2831853f * ts[i]), std::sin(6.2831853f * ts[i]) };
+	}
+	const PiecewiseLagrange<Point<2>> circle(ts, curve, 3);
+	float radius_error = 0.f;
+	for (int q = 0; q < 1000; q++) {
+		const Point<2> p = circle.compute(q / 999.f);
+		radius_error = std::max(radius_error, std::abs(std::sqrt(p[0] * p[0] + p[1] * p[1]) - 1.f));
+	}
+	std::cout << "\n[piecewise Point<2>, unit circle on " << n << " nodes] max radius error " << radius_error << std::endl;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "bench") {
+		const int queries = argc > 2 ? std::atoi(argv[2]) : 1'000'000;
+		const size_t max_threads = argc > 3 ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+		run_benchmarks(queries);
+		bench_incremental(1000, 100'000);
+		bench_piecewise(4096, queries);
+		std::cout << "\n[Point<D> compute, n = 64]" << std::endl;
+		bench_point<2>(64, queries);
+		bench_point<3>(64, queries);
+		bench_point<4>(64, queries);
+		bench_point<8>(64, queries);
+		bench_point<16>(64, queries);
+		bench_series(queries);
+		bench_derivatives(queries);
+		for (const int n : { 16, 256 }) {
+			bench_batch<float>("float", n, queries, max_threads, [](float x) { return std::sin(3.f * x); });
+			bench_batch<Point<3>>("Point<3>", n, queries, max_threads, [](float x) { return Point<3>{ std::sin(x), std::cos(x), x * x }; });
+		}
+		return EXIT_SUCCESS;
+	}
+
 	std::vector<float> xvals = {1.f, 2.f, 3.f, 4.f, 5.f};
 	std::vector<Point<2>> ps = {
 		{1.f, 5.f},
@@ -1,6 +1,25 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <cstdint>
+#include <tuple>
+#include <span>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include <unordered_map>
+#include <array>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MIXIN_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define MIXIN_X86_SIMD 0
+#endif
 
 template<typename T, typename ...Mixins>
 struct Node : public Mixins... {
@@ -12,6 +31,7 @@ struct Node : public Mixins... {
 struct Color {
 	uint32_t rgba;
 	Color() : rgba(0) {}
+	Color(uint32_t rgba) : rgba(rgba) {}
 
 	uint8_t get_red() const {
 		return (this->rgba >> 24);
@@ -53,7 +73,1094 @@ struct IndexLinks {
 	IndexLinks(int p, int n) : prev(p), next(n) {}
 };
 
-int main() {
+/** Instruction sets the ColorBatch kernels can run on, from least to most capable */
+enum ColorIsa {
+	CI_SCALAR,
+	CI_SSSE3,
+	CI_AVX2
+};
+
+/** Batch kernels over packed Colors: planar channel extraction, alpha blending, premultiplication and the
+ * RGBA <-> BGRA swizzle. Every kernel has a scalar version and SSSE3 / AVX2 versions built on byte
+ * shuffles, and runs the best one the CPU supports unless told otherwise. All versions give the same
+ * bytes: products of two channels are divided by 255 with exact rounding, see div255.
+ *
+ * A Color's rgba keeps red in the top byte, so in (little endian) memory a pixel reads A, B, G, R. */
+struct ColorBatch {
+	static_assert(sizeof(Color) == sizeof(uint32_t), "ColorBatch reads Colors as packed uint32_t");
+
+	/** The most capable instruction set this CPU has. Checked once. */
+	static ColorIsa best_isa() {
+#if MIXIN_X86_SIMD
+		static const ColorIsa best = __builtin_cpu_supports("avx2") ? CI_AVX2
+			: (__builtin_cpu_supports("ssse3") ? CI_SSSE3 : CI_SCALAR);
+		return best;
+#else
+		return CI_SCALAR;
+#endif
+	}
+
+	/** round(x / 255) for x in [0, 255 * 255], without a division */
+	static uint32_t div255(uint32_t x) {
+		return (x + 128 + ((x + 128) >> 8)) >> 8;
+	}
+
+	/** Splits `in` into one byte array per channel, each at least as long as `in` */
+	static void split_channels(std::span<const Color> in, std::span<uint8_t> red, std::span<uint8_t> green,
+		std::span<uint8_t> blue, std::span<uint8_t> alpha, ColorIsa isa = ColorBatch::best_isa()) {
+		if (red.size() < in.size() || green.size() < in.size() || blue.size() < in.size() || alpha.size() < in.size()) {
+			std::cout << "ColorBatch::split_channels was given a channel shorter than its input" << std::endl;
+			abort();
+		}
+
+		const uint32_t* pixels = reinterpret_cast<const uint32_t*>(in.data());
+		uint8_t* channels[4] = { alpha.data(), blue.data(), green.data(), red.data() }; // memory order
+		size_t done = 0;
+#if MIXIN_X86_SIMD
+		isa = std::min(isa, ColorBatch::best_isa());
+		done = isa == CI_AVX2 ? ColorBatch::split_avx2(pixels, channels, in.size())
+			: (isa == CI_SSSE3 ? ColorBatch::split_ssse3(pixels, channels, in.size()) : 0);
+#endif
+		for (size_t i = done; i < in.size(); i++) {
+			for (size_t c = 0; c < 4; c++) {
+				channels[c][i] = (uint8_t) (pixels[i] >> (8 * c));
+			}
+		}
+	}
+
+	/** Writes `in` with red and blue swapped to `out` (which may be `in`). RGBA to BGRA and back are the same swap. */
+	static void swizzle_rgba_bgra(std::span<const Color> in, std::span<Color> out, ColorIsa isa = ColorBatch::best_isa()) {
+		ColorBatch::check_output("swizzle_rgba_bgra", in.size(), out.size());
+		const uint32_t* pixels = reinterpret_cast<const uint32_t*>(in.data());
+		uint32_t* result = reinterpret_cast<uint32_t*>(out.data());
+		size_t done = 0;
+#if MIXIN_X86_SIMD
+		isa = std::min(isa, ColorBatch::best_isa());
+		done = isa == CI_AVX2 ? ColorBatch::swizzle_avx2(pixels, result, in.size())
+			: (isa == CI_SSSE3 ? ColorBatch::swizzle_ssse3(pixels, result, in.size()) : 0);
+#endif
+		for (size_t i = done; i < in.size(); i++) {
+			const uint32_t p = pixels[i];
+			result[i] = (p & 0x00FF00FFu) | ((p >> 16) & 0xFF00u) | ((p & 0xFF00u) << 16);
+		}
+	}
+
+	/** Writes `in` with red, green and blue scaled by alpha to `out` (which may be `in`) */
+	static void premultiply(std::span<const Color> in, std::span<Color> out, ColorIsa isa = ColorBatch::best_isa()) {
+		ColorBatch::check_output("premultiply", in.size(), out.size());
+		const uint32_t* pixels = reinterpret_cast<const uint32_t*>(in.data());
+		uint32_t* result = reinterpret_cast<uint32_t*>(out.data());
+		size_t done = 0;
+#if MIXIN_X86_SIMD
+		isa = std::min(isa, ColorBatch::best_isa());
+		done = isa == CI_AVX2 ? ColorBatch::premultiply_avx2(pixels, result, in.size())
+			: (isa == CI_SSSE3 ? ColorBatch::premultiply_ssse3(pixels, result, in.size()) : 0);
+#endif
+		for (size_t i = done; i < in.size(); i++) {
+			const uint32_t p = pixels[i];
+			const uint32_t a = p & 0xFF;
+			uint32_t premultiplied = a;
+			for (size_t c = 1; c < 4; c++) {
+				premultiplied |= ColorBatch::div255(((p >> (8 * c)) & 0xFF) * a) << (8 * c);
+			}
+			result[i] = premultiplied;
+		}
+	}
+
+	/** Composites `src` over `dst` (straight alpha) into `out`, which may be either of them:
+	 * out = (src * src_alpha + dst * (255 - src_alpha)) / 255 for red, green and blue, and
+	 * out_alpha = src_alpha + dst_alpha * (255 - src_alpha) / 255 */
+	static void blend_over(std::span<const Color> src, std::span<const Color> dst, std::span<Color> out,
+		ColorIsa isa = ColorBatch::best_isa()) {
+		ColorBatch::check_output("blend_over", src.size(), dst.size());
+		ColorBatch::check_output("blend_over", src.size(), out.size());
+		const uint32_t* over = reinterpret_cast<const uint32_t*>(src.data());
+		const uint32_t* under = reinterpret_cast<const uint32_t*>(dst.data());
+		uint32_t* result = reinterpret_cast<uint32_t*>(out.data());
+		size_t done = 0;
+#if MIXIN_X86_SIMD
+		isa = std::min(isa, ColorBatch::best_isa());
+		done = isa == CI_AVX2 ? ColorBatch::blend_avx2(over, under, result, src.size())
+			: (isa == CI_SSSE3 ? ColorBatch::blend_ssse3(over, under, result, src.size()) : 0);
+#endif
+		for (size_t i = done; i < src.size(); i++) {
+			const uint32_t a = over[i] & 0xFF;
+			uint32_t blended = ColorBatch::div255(255 * a + (under[i] & 0xFF) * (255 - a));
+			for (size_t c = 1; c < 4; c++) {
+				const uint32_t s = (over[i] >> (8 * c)) & 0xFF;
+				const uint32_t d = (under[i] >> (8 * c)) & 0xFF;
+				blended |= ColorBatch::div255(s * a + d * (255 - a)) << (8 * c);
+			}
+			result[i] = blended;
+		}
+	}
+
+private:
+	static void check_output(const char* kernel, size_t in, size_t out) {
+		if (out < in) {
+			std::cout << "ColorBatch::" << kernel << " was given an output shorter than its input" << std::endl;
+			abort();
+		}
+	}
+
+#if MIXIN_X86_SIMD
+	// The vector versions handle whole vectors only and return how many pixels they did.
+	// Everything works within 128 bit lanes, so the AVX2 versions are the SSSE3 ones twice over.
+
+	/** Gathers each channel of 4 pixels into its own 4 bytes: A0..A3 B0..B3 G0..G3 R0..R3 */
+	static constexpr char PLANAR[16] = { 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15 };
+	/** Swaps bytes 1 (blue) and 3 (red) of every pixel */
+	static constexpr char SWAP_RED_BLUE[16] = { 0, 3, 2, 1, 4, 7, 6, 5, 8, 11, 10, 9, 12, 15, 14, 13 };
+	/** Copies the alpha word of each of 2 pixels widened to 16 bits over all four of its words */
+	static constexpr char SPREAD_ALPHA[16] = { 0, 1, 0, 1, 0, 1, 0, 1, 8, 9, 8, 9, 8, 9, 8, 9 };
+
+	__attribute__((target("ssse3")))
+	static __m128i div255_ssse3(__m128i x) {
+		const __m128i rounded = _mm_add_epi16(x, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(rounded, _mm_srli_epi16(rounded, 8)), 8);
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i div255_avx2(__m256i x) {
+		const __m256i rounded = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(rounded, _mm256_srli_epi16(rounded, 8)), 8);
+	}
+
+	/** 16 pixels per round: each pixel vector is shuffled to planar order, then the 4x4 grid of
+	 * 4 byte groups is transposed so every vector holds one channel of all 16 pixels */
+	__attribute__((target("ssse3")))
+	static size_t split_ssse3(const uint32_t* pixels, uint8_t* const* channels, size_t n) {
+		const __m128i planar = _mm_loadu_si128(reinterpret_cast<const __m128i*>(PLANAR));
+		size_t i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m128i v[4];
+			for (size_t k = 0; k < 4; k++) {
+				v[k] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i + 4 * k)), planar);
+			}
+
+			const __m128i ab01 = _mm_unpacklo_epi32(v[0], v[1]);
+			const __m128i gr01 = _mm_unpackhi_epi32(v[0], v[1]);
+			const __m128i ab23 = _mm_unpacklo_epi32(v[2], v[3]);
+			const __m128i gr23 = _mm_unpackhi_epi32(v[2], v[3]);
+			const __m128i planes[4] = {
+				_mm_unpacklo_epi64(ab01, ab23), _mm_unpackhi_epi64(ab01, ab23),
+				_mm_unpacklo_epi64(gr01, gr23), _mm_unpackhi_epi64(gr01, gr23)
+			};
+			for (size_t c = 0; c < 4; c++) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(channels[c] + i), planes[c]);
+			}
+		}
+
+		return i;
+	}
+
+	/** 32 pixels per round: as split_ssse3, with a cross-lane permute putting each channel's two
+	 * 4 byte groups side by side before the 64 bit transpose */
+	__attribute__((target("avx2")))
+	static size_t split_avx2(const uint32_t* pixels, uint8_t* const* channels, size_t n) {
+		const __m256i planar = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(PLANAR)));
+		const __m256i pair_up = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+		size_t i = 0;
+		for (; i + 32 <= n; i += 32) {
+			__m256i v[4];
+			for (size_t k = 0; k < 4; k++) {
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i + 8 * k));
+				v[k] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(block, planar), pair_up);
+			}
+
+			// per 128 bit lane: low holds A then G, high holds B then R
+			const __m256i low01 = _mm256_unpacklo_epi64(v[0], v[1]);
+			const __m256i high01 = _mm256_unpackhi_epi64(v[0], v[1]);
+			const __m256i low23 = _mm256_unpacklo_epi64(v[2], v[3]);
+			const __m256i high23 = _mm256_unpackhi_epi64(v[2], v[3]);
+			const __m256i planes[4] = {
+				_mm256_permute2x128_si256(low01, low23, 0x20), _mm256_permute2x128_si256(high01, high23, 0x20),
+				_mm256_permute2x128_si256(low01, low23, 0x31), _mm256_permute2x128_si256(high01, high23, 0x31)
+			};
+			for (size_t c = 0; c < 4; c++) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(channels[c] + i), planes[c]);
+			}
+		}
+
+		return i;
+	}
+
+	__attribute__((target("ssse3")))
+	static size_t swizzle_ssse3(const uint32_t* pixels, uint32_t* out, size_t n) {
+		const __m128i swap = _mm_loadu_si128(reinterpret_cast<const __m128i*>(SWAP_RED_BLUE));
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(block, swap));
+		}
+
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	static size_t swizzle_avx2(const uint32_t* pixels, uint32_t* out, size_t n) {
+		const __m256i swap = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(SWAP_RED_BLUE)));
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_shuffle_epi8(block, swap));
+		}
+
+		return i;
+	}
+
+	/** Weights of 2 pixels widened to 16 bits: alpha over the colour words and 255 over the alpha word, so
+	 * that weight * channel / 255 premultiplies the colours and keeps alpha as is */
+	__attribute__((target("ssse3")))
+	static __m128i alpha_weights_ssse3(__m128i wide) {
+		const __m128i alpha_words = _mm_setr_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		const __m128i spread = _mm_shuffle_epi8(wide, _mm_loadu_si128(reinterpret_cast<const __m128i*>(SPREAD_ALPHA)));
+		return _mm_or_si128(_mm_andnot_si128(alpha_words, spread), _mm_and_si128(alpha_words, _mm_set1_epi16(255)));
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i alpha_weights_avx2(__m256i wide) {
+		const __m256i alpha_words = _mm256_setr_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+		const __m256i spread = _mm256_shuffle_epi8(wide,
+			_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(SPREAD_ALPHA))));
+		return _mm256_or_si256(_mm256_andnot_si256(alpha_words, spread), _mm256_and_si256(alpha_words, _mm256_set1_epi16(255)));
+	}
+
+	__attribute__((target("ssse3")))
+	static size_t premultiply_ssse3(const uint32_t* pixels, uint32_t* out, size_t n) {
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+			const __m128i low = _mm_unpacklo_epi8(block, zero);
+			const __m128i high = _mm_unpackhi_epi8(block, zero);
+			const __m128i low_scaled = ColorBatch::div255_ssse3(_mm_mullo_epi16(low, ColorBatch::alpha_weights_ssse3(low)));
+			const __m128i high_scaled = ColorBatch::div255_ssse3(_mm_mullo_epi16(high, ColorBatch::alpha_weights_ssse3(high)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low_scaled, high_scaled));
+		}
+
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	static size_t premultiply_avx2(const uint32_t* pixels, uint32_t* out, size_t n) {
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+			const __m256i low = _mm256_unpacklo_epi8(block, zero);
+			const __m256i high = _mm256_unpackhi_epi8(block, zero);
+			const __m256i low_scaled = ColorBatch::div255_avx2(_mm256_mullo_epi16(low, ColorBatch::alpha_weights_avx2(low)));
+			const __m256i high_scaled = ColorBatch::div255_avx2(_mm256_mullo_epi16(high, ColorBatch::alpha_weights_avx2(high)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_packus_epi16(low_scaled, high_scaled));
+		}
+
+		return i;
+	}
+
+	/** src * weights + dst * (255 - src alpha), divided by 255, for 2 pixels widened to 16 bits. Neither
+	 * sum can pass 255 * 255, so the 16 bit words never wrap. */
+	__attribute__((target("ssse3")))
+	static __m128i blend_wide_ssse3(__m128i over, __m128i under) {
+		const __m128i weights = ColorBatch::alpha_weights_ssse3(over);
+		const __m128i spread = _mm_shuffle_epi8(over, _mm_loadu_si128(reinterpret_cast<const __m128i*>(SPREAD_ALPHA)));
+		const __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), spread);
+		return ColorBatch::div255_ssse3(_mm_add_epi16(_mm_mullo_epi16(over, weights), _mm_mullo_epi16(under, inverse)));
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i blend_wide_avx2(__m256i over, __m256i under) {
+		const __m256i weights = ColorBatch::alpha_weights_avx2(over);
+		const __m256i spread = _mm256_shuffle_epi8(over,
+			_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(SPREAD_ALPHA))));
+		const __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), spread);
+		return ColorBatch::div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(over, weights), _mm256_mullo_epi16(under, inverse)));
+	}
+
+	__attribute__((target("ssse3")))
+	static size_t blend_ssse3(const uint32_t* over, const uint32_t* under, uint32_t* out, size_t n) {
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(over + i));
+			const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(under + i));
+			const __m128i low = ColorBatch::blend_wide_ssse3(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			const __m128i high = ColorBatch::blend_wide_ssse3(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+		}
+
+		return i;
+	}
+
+	__attribute__((target("avx2")))
+	static size_t blend_avx2(const uint32_t* over, const uint32_t* under, uint32_t* out, size_t n) {
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(over + i));
+			const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(under + i));
+			const __m256i low = ColorBatch::blend_wide_avx2(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+			const __m256i high = ColorBatch::blend_wide_avx2(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_packus_epi16(low, high));
+		}
+
+		return i;
+	}
+#endif
+};
+
+/** Reference to one mixin stored in a MixinVector column. Specialized per mixin to forward its
+ * fields and methods, so that a NodeRef reads like the Node it stands in for. */
+template <typename M>
+struct ColumnRef {
+	M& mixin;
+	ColumnRef(M& m) : mixin(m) {}
+};
+
+template <>
+struct ColumnRef<Color> {
+	Color& mixin;
+	uint32_t& rgba;
+	ColumnRef(Color& m) : mixin(m), rgba(m.rgba) {}
+
+	uint8_t get_red() const {
+		return this->mixin.get_red();
+	}
+
+	uint8_t get_green() const {
+		return this->mixin.get_green();
+	}
+
+	uint8_t get_blue() const {
+		return this->mixin.get_blue();
+	}
+
+	uint8_t get_alpha() const {
+		return this->mixin.get_alpha();
+	}
+};
+
+template <>
+struct ColumnRef<Distance> {
+	Distance& mixin;
+	float& distance;
+	ColumnRef(Distance& m) : mixin(m), distance(m.distance) {}
+
+	float get_distance() const {
+		return this->mixin.get_distance();
+	}
+
+	void set_distance(float f) {
+		this->mixin.set_distance(f);
+	}
+};
+
+template <>
+struct ColumnRef<IndexLinks> {
+	IndexLinks& mixin;
+	int& prev;
+	int& next;
+	ColumnRef(IndexLinks& m) : mixin(m), prev(m.prev), next(m.next) {}
+};
+
+/** What MixinVector::operator[] hands out: the item and one ColumnRef per mixin, pointing into the columns */
+template <typename T, typename ...Mixins>
+struct NodeRef : public ColumnRef<Mixins>... {
+	T& item;
+	NodeRef(T& item, Mixins&... mixins) : ColumnRef<Mixins>(mixins)..., item(item) {}
+
+	/** The mixin M of this node, as stored in its column */
+	template <typename M>
+	M& as() const {
+		return static_cast<const ColumnRef<M>&>(*this).mixin;
+	}
+};
+
+/** Node<T, Mixins...> stored as a structure of arrays: the items and every mixin live in their own
+ * contiguous column, so a pass that only touches Distance streams through distances and nothing else.
+ * operator[] returns a NodeRef that exposes the same fields and methods as a Node. */
+template <typename T, typename ...Mixins>
+struct MixinVector {
+	std::vector<T> items;
+	std::tuple<std::vector<Mixins>...> columns;
+
+	size_t size() const {
+		return this->items.size();
+	}
+
+	void reserve(size_t n) {
+		this->items.reserve(n);
+		(std::get<std::vector<Mixins>>(this->columns).reserve(n), ...);
+	}
+
+	/** Appends a node with default constructed mixins */
+	void push_back(T item) {
+		this->items.push_back(std::move(item));
+		(std::get<std::vector<Mixins>>(this->columns).push_back(Mixins()), ...);
+	}
+
+	/** Appends a copy of `node`, split across the columns */
+	void push_back(const Node<T, Mixins...>& node) {
+		this->items.push_back(node.item);
+		(std::get<std::vector<Mixins>>(this->columns).push_back(static_cast<const Mixins&>(node)), ...);
+	}
+
+	NodeRef<T, Mixins...> operator[](size_t i) {
+		return NodeRef<T, Mixins...>(this->items[i], std::get<std::vector<Mixins>>(this->columns)[i]...);
+	}
+
+	/** Rebuilds node i as a Node, copying every column */
+	Node<T, Mixins...> gather(size_t i) const {
+		Node<T, Mixins...> node(this->items[i]);
+		((static_cast<Mixins&>(node) = std::get<std::vector<Mixins>>(this->columns)[i]), ...);
+		return node;
+	}
+
+	/** The whole column of mixin M, for loops that only need that one field */
+	template <typename M>
+	std::span<M> column() {
+		return std::span<M>(std::get<std::vector<M>>(this->columns));
+	}
+
+	template <typename M>
+	std::span<const M> column() const {
+		return std::span<const M>(std::get<std::vector<M>>(this->columns));
+	}
+};
+
+/** Position of M in Ms..., a compile error if M is not there */
+template <typename M, typename ...Ms>
+struct MixinIndex;
+
+template <typename M, typename ...Ms>
+struct MixinIndex<M, M, Ms...> {
+	static constexpr size_t value = 0;
+};
+
+template <typename M, typename First, typename ...Ms>
+struct MixinIndex<M, First, Ms...> {
+	static constexpr size_t value = 1 + MixinIndex<M, Ms...>::value;
+};
+
+/** Stable reference to an entity in an ArchetypeStore. It stays valid until that entity is
+ * destroyed, after which it may be recycled by a later create. */
+typedef uint32_t EntityId;
+
+/** Entity storage for the Node<T, Mixins...> pattern when entities carry different subsets of Mixins.
+ * Every subset in use (an archetype, named by a bitmask over Mixins) keeps its entities in 16 KB chunks,
+ * each chunk holding one contiguous column per mixin of the archetype plus the items and entity ids.
+ * query<Qs...>() walks every archetype whose mask contains Qs at compile-time-known bits, and adding
+ * or removing a mixin moves the entity to its new archetype and fills its old row with the archetype's
+ * last entity, so every chunk but the last of an archetype stays full.
+ * Items and mixins are copied around with memcpy, so they must be trivially copyable. */
+template <typename T, typename ...Mixins>
+struct ArchetypeStore {
+	static_assert(sizeof...(Mixins) <= 32, "ArchetypeStore masks hold up to 32 mixins");
+	static_assert((std::is_trivially_copyable_v<T> && ... && std::is_trivially_copyable_v<Mixins>),
+		"ArchetypeStore moves items and mixins with memcpy");
+
+	static constexpr size_t CHUNK_BYTES = 16 * 1024;
+	static constexpr size_t COLUMN_ALIGN = 64;
+	static constexpr size_t MIXINS = sizeof...(Mixins);
+	static constexpr size_t ABSENT = static_cast<size_t>(-1);
+
+	template <typename ...Ms>
+	static constexpr uint32_t mask_of() {
+		return (uint32_t(0) | ... | (uint32_t(1) << MixinIndex<Ms, Mixins...>::value));
+	}
+
+	struct Chunk {
+		alignas(COLUMN_ALIGN) std::byte bytes[CHUNK_BYTES];
+		size_t count = 0;
+	};
+
+	struct Archetype {
+		uint32_t mask;
+		size_t capacity;                      // entities per chunk
+		size_t id_offset;
+		size_t item_offset;
+		std::array<size_t, MIXINS> offsets;   // column of each mixin in a chunk, ABSENT if not in the mask
+		std::vector<std::unique_ptr<Chunk>> chunks;
+
+		template <typename M>
+		M* column(Chunk& chunk) const {
+			return reinterpret_cast<M*>(chunk.bytes + this->offsets[MixinIndex<M, Mixins...>::value]);
+		}
+
+		EntityId* ids(Chunk& chunk) const {
+			return reinterpret_cast<EntityId*>(chunk.bytes + this->id_offset);
+		}
+
+		T* items(Chunk& chunk) const {
+			return reinterpret_cast<T*>(chunk.bytes + this->item_offset);
+		}
+	};
+
+	struct EntityLocation {
+		uint32_t archetype;
+		uint32_t chunk;
+		uint32_t row;
+	};
+
+	static constexpr size_t MIXIN_SIZES[MIXINS > 0 ? MIXINS : 1] = { sizeof(Mixins)... };
+
+	std::vector<Archetype> archetypes;
+	std::unordered_map<uint32_t, uint32_t> archetype_of_mask;
+	std::vector<EntityLocation> locations; // EntityId -> where its row is
+	std::vector<EntityId> free_ids;
+	size_t alive = 0;
+
+	/** Number of live entities */
+	size_t size() const {
+		return this->alive;
+	}
+
+	/** Creates an entity carrying `item` and exactly the mixins passed in */
+	template <typename ...Ms>
+	EntityId create(T item, Ms... mixins) {
+		EntityId e;
+		if (this->free_ids.empty()) {
+			e = (EntityId) this->locations.size();
+			this->locations.push_back({});
+		} else {
+			e = this->free_ids.back();
+			this->free_ids.pop_back();
+		}
+
+		const uint32_t a = this->archetype_for(ArchetypeStore::mask_of<Ms...>());
+		const EntityLocation at = this->append_row(a, e);
+		Archetype& archetype = this->archetypes[a];
+		Chunk& chunk = *archetype.chunks[at.chunk];
+		archetype.items(chunk)[at.row] = item;
+		((archetype.template column<Ms>(chunk)[at.row] = mixins), ...);
+		this->alive++;
+		return e;
+	}
+
+	/** Destroys `e` and releases its id */
+	void destroy(EntityId e) {
+		this->remove_row(this->locations[e]);
+		this->free_ids.push_back(e);
+		this->alive--;
+	}
+
+	/** Evaluates to true if `e` carries mixin M */
+	template <typename M>
+	bool has(EntityId e) const {
+		return (this->archetypes[this->locations[e].archetype].mask & ArchetypeStore::mask_of<M>()) != 0;
+	}
+
+	/** The mixin M of `e`, which must carry it. Invalidated by any create, destroy, add or remove. */
+	template <typename M>
+	M& get(EntityId e) {
+		const EntityLocation at = this->locations[e];
+		Archetype& archetype = this->archetypes[at.archetype];
+		return archetype.template column<M>(*archetype.chunks[at.chunk])[at.row];
+	}
+
+	T& item(EntityId e) {
+		const EntityLocation at = this->locations[e];
+		Archetype& archetype = this->archetypes[at.archetype];
+		return archetype.items(*archetype.chunks[at.chunk])[at.row];
+	}
+
+	/** Gives `e` the mixin M, moving it to the archetype with M added */
+	template <typename M>
+	void add(EntityId e, M mixin) {
+		if (this->has<M>(e)) {
+			std::cout << "ArchetypeStore::add was given an entity that already has the mixin" << std::endl;
+			abort();
+		}
+
+		const uint32_t mask = this->archetypes[this->locations[e].archetype].mask | ArchetypeStore::mask_of<M>();
+		this->move_to(e, this->archetype_for(mask));
+		this->get<M>(e) = mixin;
+	}
+
+	/** Takes the mixin M away from `e`, moving it to the archetype with M removed */
+	template <typename M>
+	void remove(EntityId e) {
+		if (!this->has<M>(e)) {
+			std::cout << "ArchetypeStore::remove was given an entity without the mixin" << std::endl;
+			abort();
+		}
+
+		const uint32_t mask = this->archetypes[this->locations[e].archetype].mask & ~ArchetypeStore::mask_of<M>();
+		this->move_to(e, this->archetype_for(mask));
+	}
+
+	/** Calls fn(count, Qs* columns...) once per chunk of every archetype carrying all of Qs, for loops
+	 * that want to run straight over the columns */
+	template <typename ...Qs, typename F>
+	void query_chunks(F&& fn) {
+		constexpr uint32_t wanted = ArchetypeStore::mask_of<Qs...>();
+		for (Archetype& archetype : this->archetypes) {
+			if ((archetype.mask & wanted) != wanted) {
+				continue;
+			}
+
+			for (std::unique_ptr<Chunk>& chunk : archetype.chunks) {
+				fn(chunk->count, archetype.template column<Qs>(*chunk)...);
+			}
+		}
+	}
+
+	/** Calls fn(Qs&...) for every entity carrying all of Qs */
+	template <typename ...Qs, typename F>
+	void query(F&& fn) {
+		this->query_chunks<Qs...>([&fn](size_t count, Qs*... columns) {
+			for (size_t row = 0; row < count; row++) {
+				fn(columns[row]...);
+			}
+		});
+	}
+
+private:
+	static size_t align_up(size_t offset) {
+		return (offset + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+	}
+
+	uint32_t archetype_for(uint32_t mask) {
+		const auto found = this->archetype_of_mask.find(mask);
+		if (found != this->archetype_of_mask.end()) {
+			return found->second;
+		}
+
+		// each column starts on a COLUMN_ALIGN boundary, so leave that much slack per column
+		Archetype archetype;
+		archetype.mask = mask;
+		size_t row_bytes = sizeof(EntityId) + sizeof(T);
+		size_t columns = 2;
+		for (size_t m = 0; m < MIXINS; m++) {
+			if (mask & (uint32_t(1) << m)) {
+				row_bytes += MIXIN_SIZES[m];
+				columns++;
+			}
+		}
+		archetype.capacity = (CHUNK_BYTES - columns * COLUMN_ALIGN) / row_bytes;
+
+		size_t offset = 0;
+		archetype.id_offset = offset;
+		offset = align_up(offset + archetype.capacity * sizeof(EntityId));
+		archetype.item_offset = offset;
+		offset = align_up(offset + archetype.capacity * sizeof(T));
+		for (size_t m = 0; m < MIXINS; m++) {
+			archetype.offsets[m] = ABSENT;
+			if (mask & (uint32_t(1) << m)) {
+				archetype.offsets[m] = offset;
+				offset = align_up(offset + archetype.capacity * MIXIN_SIZES[m]);
+			}
+		}
+
+		this->archetypes.push_back(std::move(archetype));
+		this->archetype_of_mask[mask] = (uint32_t) (this->archetypes.size() - 1);
+		return (uint32_t) (this->archetypes.size() - 1);
+	}
+
+	/** Claims the row after the last entity of archetype `a` for `e` */
+	EntityLocation append_row(uint32_t a, EntityId e) {
+		Archetype& archetype = this->archetypes[a];
+		if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.capacity) {
+			archetype.chunks.push_back(std::unique_ptr<Chunk>(new Chunk)); // rows are written before they are read, skip zeroing
+		}
+
+		Chunk& chunk = *archetype.chunks.back();
+		const EntityLocation at = { a, (uint32_t) (archetype.chunks.size() - 1), (uint32_t) chunk.count++ };
+		archetype.ids(chunk)[at.row] = e;
+		this->locations[e] = at;
+		return at;
+	}
+
+	/** Fills the row at `at` with the last entity of its archetype, dropping the last chunk once it is empty */
+	void remove_row(EntityLocation at) {
+		Archetype& archetype = this->archetypes[at.archetype];
+		Chunk& chunk = *archetype.chunks[at.chunk];
+		Chunk& last = *archetype.chunks.back();
+		const size_t last_row = last.count - 1;
+
+		if (&chunk != &last || at.row != last_row) {
+			const EntityId moved = archetype.ids(last)[last_row];
+			archetype.ids(chunk)[at.row] = moved;
+			archetype.items(chunk)[at.row] = archetype.items(last)[last_row];
+			for (size_t m = 0; m < MIXINS; m++) {
+				if (archetype.offsets[m] != ABSENT) {
+					std::memcpy(chunk.bytes + archetype.offsets[m] + at.row * MIXIN_SIZES[m],
+						last.bytes + archetype.offsets[m] + last_row * MIXIN_SIZES[m], MIXIN_SIZES[m]);
+				}
+			}
+			this->locations[moved] = at;
+		}
+
+		if (--last.count == 0) {
+			archetype.chunks.pop_back();
+		}
+	}
+
+	/** Moves `e` into archetype `to`, keeping the mixins both archetypes have */
+	void move_to(EntityId e, uint32_t to) {
+		const EntityLocation from = this->locations[e];
+		const EntityLocation at = this->append_row(to, e);
+		Archetype& source = this->archetypes[from.archetype];
+		Archetype& target = this->archetypes[to];
+		Chunk& source_chunk = *source.chunks[from.chunk];
+		Chunk& target_chunk = *target.chunks[at.chunk];
+
+		target.items(target_chunk)[at.row] = source.items(source_chunk)[from.row];
+		for (size_t m = 0; m < MIXINS; m++) {
+			if (source.offsets[m] != ABSENT && target.offsets[m] != ABSENT) {
+				std::memcpy(target_chunk.bytes + target.offsets[m] + at.row * MIXIN_SIZES[m],
+					source_chunk.bytes + source.offsets[m] + from.row * MIXIN_SIZES[m], MIXIN_SIZES[m]);
+			}
+		}
+
+		this->remove_row(from);
+	}
+};
+
+/** Moves the nodes of an IndexLinks-threaded vector into traversal order in O(n): the list starting at
+ * `head` ends up at indices 0, 1, 2, ... with next = i + 1 and prev = i - 1, so walking it streams through
+ * memory. Nodes are moved out as the list is walked, so the scattered reads are paid for once. Nodes the
+ * list never reaches keep their relative order after it, their links remapped, -1 meaning no node.
+ * Returns the new head, 0 or -1 for an empty list. */
+template <typename NodeT>
+int relinearize(std::vector<NodeT>& nodes, int head) {
+	static_assert(std::is_base_of_v<IndexLinks, NodeT>, "relinearize walks the IndexLinks mixin");
+	constexpr int UNPLACED = -1;
+	std::vector<int> rank(nodes.size(), UNPLACED); // old index -> new index
+	std::vector<NodeT> relinearized;
+	relinearized.reserve(nodes.size());
+
+	for (int p = head; p != -1; p = nodes[p].next) {
+		if (rank[p] != UNPLACED) {
+			std::cout << "relinearize was given a list that loops back on itself" << std::endl;
+			abort();
+		}
+
+		rank[p] = (int) relinearized.size();
+		relinearized.push_back(std::move(nodes[p]));
+	}
+
+	const int reached = (int) relinearized.size();
+	for (int k = 0; k < reached; k++) {
+		relinearized[k].prev = k - 1;
+		relinearized[k].next = k + 1 < reached ? k + 1 : -1;
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (rank[i] == UNPLACED) {
+			rank[i] = (int) relinearized.size();
+			relinearized.push_back(std::move(nodes[i]));
+		}
+	}
+
+	for (size_t k = reached; k < relinearized.size(); k++) {
+		IndexLinks& links = relinearized[k];
+		links.prev = links.prev == -1 ? -1 : rank[links.prev];
+		links.next = links.next == -1 ? -1 : rank[links.next];
+	}
+
+	nodes.swap(relinearized);
+	return head == -1 ? -1 : 0;
+}
+
+/** Calls fn(node) for every node of the IndexLinks-threaded list starting at `head`. A second cursor
+ * runs `distance` hops ahead and prefetches the node it lands on, so the cache misses of the walk overlap
+ * with the work fn does on the nodes behind it. A distance of 0 is a plain walk. */
+template <typename Nodes, typename F>
+void for_each_linked(Nodes& nodes, int head, F&& fn, size_t distance = 8) {
+	int ahead = head;
+	for (size_t d = 0; d < distance && ahead != -1; d++) {
+		ahead = nodes[ahead].next;
+		if (ahead != -1) {
+			__builtin_prefetch(&nodes[ahead]);
+		}
+	}
+
+	for (int p = head; p != -1; p = nodes[p].next) {
+		if (ahead != -1) {
+			ahead = nodes[ahead].next;
+			if (ahead != -1) {
+				__builtin_prefetch(&nodes[ahead]);
+			}
+		}
+		fn(nodes[p]);
+	}
+}
+
+/** Times `f` and prints it as "<label> took <n>ms" */
+template <typename F>
+double time_ms(const std::string& label, F&& f) {
+	using std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	const auto t1 = high_resolution_clock::now();
+	f();
+	const auto t2 = high_resolution_clock::now();
+
+	const double ms = duration<double, std::milli>(t2 - t1).count();
+	std::cout << label << " took " << ms << "ms" << std::endl;
+	return ms;
+}
+
+/** Sums distance over n nodes stored as std::vector<Node> (AoS) and as MixinVector (SoA). Both loops keep
+ * 8 partial sums so they are bound by memory traffic rather than by the latency of the additions. */
+void bench_distance_sum(size_t n) {
+	typedef Node<char,Distance,Color,IndexLinks> NodeA;
+	constexpr size_t PARTIALS = 8;
+	auto distance_of = [](size_t i) { return (float) (i % 1000) * 0.001f; };
+	auto report = [n](double ms, double sum, size_t bytes_per_node) {
+		std::cout << "  sum " << sum << ", " << n / ms / 1000.0 << "M nodes/s, "
+			<< n * bytes_per_node / ms / 1e6 << " GB/s streamed" << std::endl;
+	};
+
+	std::cout << "\n[distance sum over " << n << " nodes]" << std::endl;
+	{
+		std::vector<NodeA> aos(n);
+		for (size_t i = 0; i < n; i++) {
+			aos[i].distance = distance_of(i);
+		}
+
+		double sum = 0.0;
+		const double ms = time_ms("AoS std::vector<Node>", [&]() {
+			double partial[PARTIALS] = {};
+			size_t i = 0;
+			for (; i + PARTIALS <= n; i += PARTIALS) {
+				for (size_t p = 0; p < PARTIALS; p++) {
+					partial[p] += aos[i + p].get_distance();
+				}
+			}
+			for (; i < n; i++) {
+				partial[0] += aos[i].get_distance();
+			}
+			for (size_t p = 0; p < PARTIALS; p++) {
+				sum += partial[p];
+			}
+		});
+		report(ms, sum, sizeof(NodeA));
+	}
+
+	MixinVector<char,Distance,Color,IndexLinks> soa;
+	soa.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		soa.push_back((char) 0);
+		soa[i].set_distance(distance_of(i));
+	}
+
+	double sum = 0.0;
+	double ms = time_ms("SoA MixinVector::column<Distance>", [&]() {
+		const std::span<const Distance> distances = soa.column<Distance>();
+		double partial[PARTIALS] = {};
+		size_t i = 0;
+		for (; i + PARTIALS <= n; i += PARTIALS) {
+			for (size_t p = 0; p < PARTIALS; p++) {
+				partial[p] += distances[i + p].get_distance();
+			}
+		}
+		for (; i < n; i++) {
+			partial[0] += distances[i].get_distance();
+		}
+		for (size_t p = 0; p < PARTIALS; p++) {
+			sum += partial[p];
+		}
+	});
+	report(ms, sum, sizeof(Distance));
+
+	sum = 0.0;
+	ms = time_ms("SoA MixinVector::operator[]", [&]() {
+		double partial[PARTIALS] = {};
+		size_t i = 0;
+		for (; i + PARTIALS <= n; i += PARTIALS) {
+			for (size_t p = 0; p < PARTIALS; p++) {
+				partial[p] += soa[i + p].get_distance();
+			}
+		}
+		for (; i < n; i++) {
+			partial[0] += soa[i].get_distance();
+		}
+		for (size_t p = 0; p < PARTIALS; p++) {
+			sum += partial[p];
+		}
+	});
+	report(ms, sum, sizeof(Distance));
+}
+
+/** n entities spread over four archetypes, {Distance}, {Distance, Color}, {Distance, Color, IndexLinks}
+ * and {Color}: single-mixin query<Distance> throughput, per entity and per chunk, and the cost of
+ * moving entities between archetypes */
+void bench_archetypes(size_t n) {
+	typedef ArchetypeStore<char,Distance,Color,IndexLinks> Store;
+	constexpr size_t PARTIALS = 8;
+	std::cout << "\n[ArchetypeStore, " << n << " entities]" << std::endl;
+
+	Store store;
+	std::vector<EntityId> ids(n);
+	size_t with_distance = 0;
+	time_ms("create", [&]() {
+		for (size_t i = 0; i < n; i++) {
+			const Distance d((float) (i % 1000) * 0.001f);
+			switch (i % 4) {
+				case 0: ids[i] = store.create('a', d); break;
+				case 1: ids[i] = store.create('b', d, Color()); break;
+				case 2: ids[i] = store.create('c', d, Color(), IndexLinks()); break;
+				default: ids[i] = store.create('d', Color()); break;
+			}
+			with_distance += i % 4 != 3;
+		}
+	});
+
+	double sum = 0.0;
+	double ms = time_ms("query<Distance>", [&]() {
+		store.query<Distance>([&sum](const Distance& d) {
+			sum += d.distance;
+		});
+	});
+	std::cout << "  sum " << sum << ", " << with_distance / ms << " entities/ms" << std::endl;
+
+	sum = 0.0;
+	ms = time_ms("query_chunks<Distance>", [&]() {
+		float partial[PARTIALS] = {};
+		store.query_chunks<Distance>([&](size_t count, const Distance* d) {
+			size_t i = 0;
+			for (; i + PARTIALS <= count; i += PARTIALS) {
+				for (size_t p = 0; p < PARTIALS; p++) {
+					partial[p] += d[i + p].distance;
+				}
+			}
+			for (; i < count; i++) {
+				partial[0] += d[i].distance;
+			}
+		});
+		for (size_t p = 0; p < PARTIALS; p++) {
+			sum += partial[p];
+		}
+	});
+	std::cout << "  sum " << sum << ", " << with_distance / ms << " entities/ms" << std::endl;
+
+	const size_t moves = std::min<size_t>(n, 1'000'000);
+	ms = time_ms("add<IndexLinks> + remove<IndexLinks> x" + std::to_string(moves), [&]() {
+		for (size_t i = 0; i < moves; i++) {
+			const EntityId e = ids[(i * 7919) % n];
+			if (store.has<IndexLinks>(e)) {
+				store.remove<IndexLinks>(e);
+				store.add(e, IndexLinks());
+			} else {
+				store.add(e, IndexLinks());
+				store.remove<IndexLinks>(e);
+			}
+		}
+	});
+	std::cout << "  " << 2 * moves / ms / 1000.0 << "M archetype moves/s" << std::endl;
+}
+
+/** Runs every ColorBatch kernel over n random Colors on each instruction set the CPU has and reports
+ * GB/s of pixel bytes read plus written */
+void bench_color_kernels(size_t n) {
+	constexpr int ROUNDS = 5;
+	std::cout << "\n[ColorBatch, " << n << " pixels]" << std::endl;
+
+	std::vector<Color> src(n);
+	std::vector<Color> dst(n);
+	uint32_t state = 0x9E3779B9u;
+	for (size_t i = 0; i < n; i++) {
+		state = state * 1664525u + 1013904223u;
+		src[i] = Color(state);
+		dst[i] = Color(state * 2654435761u);
+	}
+	std::vector<Color> out(n);
+	std::vector<uint8_t> planes[4] = { std::vector<uint8_t>(n), std::vector<uint8_t>(n), std::vector<uint8_t>(n), std::vector<uint8_t>(n) };
+
+	const char* names[3] = { "scalar", "ssse3", "avx2" };
+	for (int isa = CI_SCALAR; isa <= ColorBatch::best_isa(); isa++) {
+		auto run = [&](const std::string& kernel, size_t bytes_per_pixel, auto&& f) {
+			const double ms = time_ms(kernel + " (" + names[isa] + ") x" + std::to_string(ROUNDS), [&]() {
+				for (int r = 0; r < ROUNDS; r++) {
+					f();
+				}
+			});
+			std::cout << "  " << (double) n * bytes_per_pixel * ROUNDS / ms / 1e6 << " GB/s" << std::endl;
+		};
+
+		run("split_channels", 8, [&]() {
+			ColorBatch::split_channels(src, planes[0], planes[1], planes[2], planes[3], (ColorIsa) isa);
+		});
+		run("swizzle_rgba_bgra", 8, [&]() {
+			ColorBatch::swizzle_rgba_bgra(src, out, (ColorIsa) isa);
+		});
+		run("premultiply", 8, [&]() {
+			ColorBatch::premultiply(src, out, (ColorIsa) isa);
+		});
+		run("blend_over", 12, [&]() {
+			ColorBatch::blend_over(src, dst, out, (ColorIsa) isa);
+		});
+	}
+}
+
+/** Threads a list through n nodes in random order, then walks it before and after relinearize, plainly
+ * and with for_each_linked prefetching. `work` rounds of arithmetic per node stand in for what a real
+ * pass would do with each node. */
+void bench_relinearize(size_t n) {
+	typedef Node<char,Distance,Color,IndexLinks> NodeA;
+	std::cout << "\n[relinearize, " << n << " shuffled nodes]" << std::endl;
+
+	std::vector<int> order(n);
+	for (size_t i = 0; i < n; i++) {
+		order[i] = (int) i;
+	}
+	uint64_t state = 0x2545F4914F6CDD1Dull;
+	for (size_t i = n; i > 1; i--) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		std::swap(order[i - 1], order[state % i]);
+	}
+
+	std::vector<NodeA> nodes(n);
+	for (size_t k = 0; k < n; k++) {
+		NodeA& node = nodes[order[k]];
+		node.distance = (float) (k % 1000) * 0.001f;
+		node.prev = k > 0 ? order[k - 1] : -1;
+		node.next = k + 1 < n ? order[k + 1] : -1;
+	}
+	int head = n > 0 ? order[0] : -1;
+
+	auto walk = [&](const std::string& label, size_t distance, int work) {
+		double sum = 0.0;
+		const double ms = time_ms(label, [&]() {
+			for_each_linked(nodes, head, [&sum, work](const NodeA& node) {
+				float d = node.get_distance();
+				for (int w = 0; w < work; w++) {
+					d = d * 0.999f + 0.001f;
+				}
+				sum += d;
+			}, distance);
+		});
+		std::cout << "  " << ms * 1e6 / std::max<size_t>(n, 1) << "ns/node, sum " << sum << std::endl;
+	};
+
+	for (const int work : { 0, 32 }) {
+		walk("shuffled walk, work " + std::to_string(work), 0, work);
+		walk("shuffled walk, prefetch 16 ahead, work " + std::to_string(work), 16, work);
+	}
+
+	time_ms("relinearize", [&]() {
+		head = relinearize(nodes, head);
+	});
+
+	for (const int work : { 0, 32 }) {
+		walk("relinearized walk, work " + std::to_string(work), 0, work);
+		walk("relinearized walk, prefetch 16 ahead, work " + std::to_string(work), 16, work);
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "bench") {
+		bench_distance_sum(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100'000'000);
+		bench_archetypes(argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 10'000'000);
+		bench_color_kernels(argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1 << 24);
+		bench_relinearize(argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 10'000'000);
+		return EXIT_SUCCESS;
+	}
+
 	typedef Node<char,Distance,Color,IndexLinks> NodeA;
 	std::vector<NodeA> V;
 